@@ -0,0 +1,170 @@
+#ifndef ARDUINO_NATIVE_H
+#define ARDUINO_NATIVE_H
+
+/**
+ * @brief Заглушка Arduino-ESP32 для сборки на ПК (env:native).
+ *
+ * Ровно то, что нужно модулям архива, декодеру RS485 и тестам: String,
+ * Print/Stream, Serial (в stdout), millis()/micros() и ESP.getCycleCount() по
+ * системным часам.
+ * Пины, Wi-Fi и прочая периферия сюда не входят — код, которому они
+ * нужны, в env:native не собирается.
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include "freertos/FreeRTOS.h"
+
+typedef uint8_t byte;
+
+#define IRAM_ATTR
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+/// Псевдослучайное число (xorshift, не криптостойкое)
+uint32_t esp_random();
+
+/**
+ * @brief Строка Arduino поверх std::string (подмножество API ядра ESP32).
+ */
+class String {
+public:
+    String(const char* s = "") : _s(s ? s : "") {}
+    String(char c) : _s(1, c) {}
+    String(int v) : _s(std::to_string(v)) {}
+    String(unsigned int v) : _s(std::to_string(v)) {}
+    String(long v) : _s(std::to_string(v)) {}
+    String(unsigned long v) : _s(std::to_string(v)) {}
+    String(long long v) : _s(std::to_string(v)) {}
+    String(unsigned long long v) : _s(std::to_string(v)) {}
+    String(float v, unsigned int decimals = 2) : String((double)v, decimals) {}
+    String(double v, unsigned int decimals = 2);
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return (unsigned int)_s.size(); }
+    bool isEmpty() const { return _s.empty(); }
+    bool reserve(unsigned int size) { _s.reserve(size); return true; }
+
+    long toInt() const { return strtol(_s.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(_s.c_str(), nullptr); }
+
+    int indexOf(char c, unsigned int from = 0) const { return _pos(_s.find(c, from)); }
+    int indexOf(const String& s, unsigned int from = 0) const { return _pos(_s.find(s._s, from)); }
+    int lastIndexOf(char c) const { return _pos(_s.rfind(c)); }
+    String substring(unsigned int from) const { return substring(from, length()); }
+    String substring(unsigned int from, unsigned int to) const;
+    bool startsWith(const String& p) const { return _s.compare(0, p._s.size(), p._s) == 0; }
+    bool endsWith(const String& p) const {
+        return _s.size() >= p._s.size() && _s.compare(_s.size() - p._s.size(), p._s.size(), p._s) == 0;
+    }
+    bool equals(const String& o) const { return _s == o._s; }
+    void trim();
+    char charAt(unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+
+    bool concat(const String& o) { _s += o._s; return true; }
+    String& operator+=(const String& o) { _s += o._s; return *this; }
+    String& operator+=(const char* o) { _s += o ? o : ""; return *this; }
+    String& operator+=(char c) { _s += c; return *this; }
+
+    char operator[](unsigned int i) const { return charAt(i); }
+    char& operator[](unsigned int i) { return _s[i]; }
+    bool operator==(const String& o) const { return _s == o._s; }
+    bool operator==(const char* o) const { return _s == (o ? o : ""); }
+    bool operator!=(const String& o) const { return _s != o._s; }
+    bool operator!=(const char* o) const { return !(*this == o); }
+    bool operator<(const String& o) const { return _s < o._s; }
+
+    friend String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+    friend String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+    friend String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+    friend String operator+(const String& a, char c) { String r(a); r += c; return r; }
+
+private:
+    static int _pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+    std::string _s;
+};
+
+/**
+ * @brief Вывод как в Arduino: наследник определяет write(uint8_t).
+ */
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t size);
+    size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    virtual void flush() {}
+
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return printf("%d", v); }
+    size_t print(unsigned int v) { return printf("%u", v); }
+    size_t print(long v) { return printf("%ld", v); }
+    size_t print(unsigned long v) { return printf("%lu", v); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    size_t println(double v, int digits) { size_t n = print(v, digits); return n + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+/**
+ * @brief Поток ввода-вывода (файлы, UART).
+ */
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    size_t readBytes(uint8_t* buf, size_t length);
+    size_t readBytes(char* buf, size_t length) { return readBytes((uint8_t*)buf, length); }
+    void setTimeout(unsigned long ms) { _timeout = ms; }
+
+protected:
+    unsigned long _timeout = 1000;
+};
+
+/**
+ * @brief Serial на ПК: вывод — в stdout, ввода нет.
+ */
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud, uint32_t config = 0, int8_t rxPin = -1, int8_t txPin = -1) {}
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    void flush() override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+/**
+ * @brief ESP на ПК: счётчик тактов идёт по наносекундам системных часов.
+ */
+class EspClass {
+public:
+    uint32_t getCycleCount();
+    uint32_t getCpuFreqMHz() { return 1000; }
+};
+
+extern EspClass ESP;
+
+#endif
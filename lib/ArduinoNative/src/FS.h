@@ -0,0 +1,92 @@
+#ifndef ARDUINO_NATIVE_FS_H
+#define ARDUINO_NATIVE_FS_H
+
+/**
+ * @brief Заглушка fs::FS/fs::File ядра ESP32 для сборки на ПК (env:native).
+ *
+ * Интерфейс тот же, что в ядре: File и FS — обёртки над FileImpl/FSImpl
+ * (FSImpl.h). Своей файловой системы здесь нет — на ПК архив работает
+ * поверх FlashEmulator или любой другой реализации FSImpl.
+ */
+
+#include <memory>
+#include "Arduino.h"
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class FileImpl;
+typedef std::shared_ptr<FileImpl> FileImplPtr;
+class FSImpl;
+typedef std::shared_ptr<FSImpl> FSImplPtr;
+
+class File : public Stream {
+public:
+    File(FileImplPtr p = FileImplPtr()) : _p(p) {}
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override;
+    size_t read(uint8_t* buf, size_t size);
+
+    bool seek(uint32_t pos, SeekMode mode);
+    bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+    size_t position() const;
+    size_t size() const;
+    bool setBufferSize(size_t size);
+    void close();
+    operator bool() const;
+    time_t getLastWrite();
+    const char* path() const;
+    const char* name() const;
+
+    bool isDirectory(void);
+    File openNextFile(const char* mode = FILE_READ);
+    String getNextFileName(void);
+    String getNextFileName(bool* isDir);
+    void rewindDirectory(void);
+
+protected:
+    FileImplPtr _p;
+};
+
+class FS {
+public:
+    FS(FSImplPtr impl) : _impl(impl) {}
+
+    File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+    File open(const String& path, const char* mode = FILE_READ, const bool create = false);
+    bool exists(const char* path);
+    bool exists(const String& path);
+    bool remove(const char* path);
+    bool remove(const String& path);
+    bool rename(const char* pathFrom, const char* pathTo);
+    bool rename(const String& pathFrom, const String& pathTo);
+    bool mkdir(const char* path);
+    bool mkdir(const String& path);
+    bool rmdir(const char* path);
+    bool rmdir(const String& path);
+
+protected:
+    FSImplPtr _impl;
+};
+
+}  // namespace fs
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef ARDUINO_NATIVE_FSIMPL_H
+#define ARDUINO_NATIVE_FSIMPL_H
+
+#include <time.h>
+#include "FS.h"
+
+namespace fs {
+
+/**
+ * @brief Реализация файла (как в ядре ESP32).
+ */
+class FileImpl {
+public:
+    virtual ~FileImpl() {}
+    virtual size_t write(const uint8_t* buf, size_t size) = 0;
+    virtual size_t read(uint8_t* buf, size_t size) = 0;
+    virtual void flush() = 0;
+    virtual bool seek(uint32_t pos, SeekMode mode) = 0;
+    virtual size_t position() const = 0;
+    virtual size_t size() const = 0;
+    virtual bool setBufferSize(size_t size) = 0;
+    virtual void close() = 0;
+    virtual time_t getLastWrite() = 0;
+    virtual const char* path() const = 0;
+    virtual const char* name() const = 0;
+    virtual bool isDirectory(void) = 0;
+    virtual FileImplPtr openNextFile(const char* mode) = 0;
+    virtual String getNextFileName(void) = 0;
+    virtual String getNextFileName(bool* isDir) = 0;
+    virtual void rewindDirectory(void) = 0;
+    virtual operator bool() = 0;
+};
+
+/**
+ * @brief Реализация файловой системы (как в ядре ESP32).
+ */
+class FSImpl {
+public:
+    virtual ~FSImpl() {}
+    virtual FileImplPtr open(const char* path, const char* mode, const bool create) = 0;
+    virtual bool exists(const char* path) = 0;
+    virtual bool rename(const char* pathFrom, const char* pathTo) = 0;
+    virtual bool remove(const char* path) = 0;
+    virtual bool mkdir(const char* path) = 0;
+    virtual bool rmdir(const char* path) = 0;
+};
+
+}  // namespace fs
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef ARDUINO_NATIVE_LITTLEFS_H
+#define ARDUINO_NATIVE_LITTLEFS_H
+
+#include "FS.h"
+
+namespace fs {
+
+/**
+ * @brief LittleFS на ПК: раздела нет, begin() возвращает false, все
+ * операции — неудачны. Нужен лишь как значение по умолчанию для
+ * ArchiveManager::begin(); тесты передают архиву FlashEmulator.
+ */
+class LittleFSFS : public FS {
+public:
+    LittleFSFS() : FS(FSImplPtr()) {}
+    bool begin(bool formatOnFail = false, const char* basePath = "/littlefs",
+               uint8_t maxOpenFiles = 10, const char* partitionLabel = "spiffs") { return false; }
+    bool format() { return false; }
+    size_t totalBytes() { return 0; }
+    size_t usedBytes() { return 0; }
+    void end() {}
+};
+
+}  // namespace fs
+
+extern fs::LittleFSFS LittleFS;
+
+#endif
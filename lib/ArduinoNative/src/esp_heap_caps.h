@@ -0,0 +1,22 @@
+#ifndef ARDUINO_NATIVE_ESP_HEAP_CAPS_H
+#define ARDUINO_NATIVE_ESP_HEAP_CAPS_H
+
+/**
+ * @brief Заглушка heap_caps для сборки на ПК (env:native): PSRAM нет,
+ * любые флаги — обычная куча.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+
+inline void* heap_caps_malloc(size_t size, uint32_t caps) { (void)caps; return malloc(size); }
+inline void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) { (void)caps; return calloc(n, size); }
+inline void  heap_caps_free(void* ptr) { free(ptr); }
+
+#endif
@@ -0,0 +1,58 @@
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <thread>
+
+struct NativeSemaphore {
+    std::recursive_timed_mutex mutex;
+};
+
+static const std::chrono::steady_clock::time_point s_boot = std::chrono::steady_clock::now();
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - s_boot).count();
+}
+
+// Обычный мьютекс тоже рекурсивный: повторный захват из той же задачи на
+// плате — ошибка, на ПК он лишь не зависнет
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return new (std::nothrow) NativeSemaphore();
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return new (std::nothrow) NativeSemaphore();
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    delete sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait) {
+    if (!sem) return pdFALSE;
+    if (wait == portMAX_DELAY) {
+        sem->mutex.lock();
+        return pdTRUE;
+    }
+    return sem->mutex.try_lock_for(std::chrono::milliseconds(wait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    if (!sem) return pdFALSE;
+    sem->mutex.unlock();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t wait) {
+    return xSemaphoreTake(sem, wait);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) {
+    return xSemaphoreGive(sem);
+}
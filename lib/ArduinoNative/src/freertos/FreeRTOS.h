@@ -0,0 +1,27 @@
+#ifndef ARDUINO_NATIVE_FREERTOS_H
+#define ARDUINO_NATIVE_FREERTOS_H
+
+/**
+ * @brief Заглушка FreeRTOS для сборки на ПК (env:native): типы, тики
+ * в миллисекундах, задержка и мьютексы (semphr.h) поверх std::thread.
+ */
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define configTICK_RATE_HZ 1000
+#define portMAX_DELAY      0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+void       vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef ARDUINO_NATIVE_FREERTOS_SEMPHR_H
+#define ARDUINO_NATIVE_FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+/// Мьютекс; на ПК — std::recursive_timed_mutex
+typedef struct NativeSemaphore* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+void              vSemaphoreDelete(SemaphoreHandle_t sem);
+BaseType_t        xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t        xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t        xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t        xSemaphoreGiveRecursive(SemaphoreHandle_t sem);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef ARDUINO_NATIVE_FREERTOS_TASK_H
+#define ARDUINO_NATIVE_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+#endif
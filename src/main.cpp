@@ -14,9 +14,13 @@
 #include "utils/RFIDManager.h"
 #include "utils/MilkSensor.h"
 #include "utils/ArchiveManager.h"
+#include "utils/DedupFilter.h"
 #include "utils/DisplayManager.h"
 #include "utils/RS485OTAUpdater.h"
 #include "utils/OTAReceiver.h"
+#ifdef ARCHIVE_BENCH
+#include "utils/ArchiveBench.h"
+#endif
 #include <LittleFS.h>
 // -----------------------------------------------------------------------------
 // === ПИНЫ ===
@@ -47,7 +51,8 @@ MQTTManager        mqttClient;      // Класс для MQTT
 RESTManager        restClient;      // Класс для REST-загрузки конфигурации
 RFIDManager        rfid;            // Класс для RFID-считывания
 MilkSensor         milkSensor;      // Класс для датчика молока
-ArchiveManager     archiveMgr;      // Класс для архива (SPIFFS)
+ArchiveManager     archiveMgr;      // Класс для архива (LittleFS)
+DedupFilter        dedupFilter;     // Отсев повторно присланных записей (Server)
 DisplayManager displayMgr(TFT_CS, TFT_DC, TFT_RST);    // Класс для LVGL-экрана
 
 WiFiClient         wifiClient;
@@ -71,6 +76,27 @@ static volatile ClientState clientState = CLIENT_IDLE;
 static volatile bool wifiConnected = false;
 static volatile unsigned long lastMQTTSend = 0;
 static const unsigned long MQTT_SEND_INTERVAL = 30 * 1000UL; // каждые 30 секунд
+static unsigned long lastCompact = 0;
+static const unsigned long COMPACT_INTERVAL = 1000UL;          // шаг уплотнения архива не чаще раза в секунду
+static TaskHandle_t archiveWriterTask = nullptr;                // ServerArchiveTask: пишет очередь приёма в архив
+// Досылка архива по MQTT: номер since в MQTT_RESYNC_TOPIC запускает выдачу
+// записей после него (ArchiveManager::readSince()) в MQTT_SYNC_TOPIC
+static const char*   MQTT_RESYNC_TOPIC = "milk/server/resync";
+static const char*   MQTT_SYNC_TOPIC   = "milk/server/sync";
+static const uint8_t MQTT_SYNC_BATCH   = 8;                     // записей за проход задачи MQTT
+static bool     mqttResync    = false;                          // оба меняются только в serverMQTTTask
+static uint64_t mqttResyncSeq = 0;
+// Опрос ПУМ сервером (RS485Manager: RS485_POLL). Адреса — из настроек
+// "rs485_clients"; пока сервер опрашивает, клиенты сами не передают
+#ifndef RS485_POLL_MAX
+#define RS485_POLL_MAX 32                                       // адресов в списке опроса
+#endif
+static const uint32_t      RS485_POLL_TIMEOUT_MS   = 50;         // ждать ответа сверх времени кадра
+static const uint32_t      RS485_POLL_IDLE_MS      = 100;        // пауза, если круг опроса пуст
+static const unsigned long RS485_MASTER_SILENCE_MS = 10000UL;    // клиент: опросов нет — передаёт сам
+static uint8_t             rs485PollAddrs[RS485_POLL_MAX];
+static size_t              rs485PollCount = 0;
+static volatile bool       otaInProgress  = false;              // ServerOTATask занимает шину
 
 // -----------------------------------------------------------------------------
 // === Декларации функций (задач) ===
@@ -82,6 +108,7 @@ void startClientMode();
 // === Задачи для Server Mode ===
 void serverMongooseTask(void *pvParameters);
 void serverRS485Task(void *pvParameters);
+void serverArchiveTask(void *pvParameters);
 void serverMQTTTask(void *pvParameters);
 void serverDisplayTask(void *pvParameters);
 
@@ -94,6 +121,29 @@ void clientDisplayTask(void *pvParameters);
 // Обработчик HTTP-запросов Mongoose
 void mongooseEventHandler(struct mg_connection *c, int ev, void *ev_data, void *fn_data);
 
+// JSON записи архива для MQTT; seq и archive_id — для синхронизации облака
+static String mqttRecordPayload(const ArchiveRecord &rec, uint64_t seq) {
+  char buf[192];
+  snprintf(buf, sizeof(buf),
+           "{\"archive_id\":%lu,\"seq\":%llu,\"pum_id\":%lu,\"cow_id\":%lu,"
+           "\"timestamp\":%lu,\"volume\":%.2f,\"ec\":%.2f}",
+           (unsigned long)archiveMgr.archiveId(), (unsigned long long)seq,
+           (unsigned long)rec.client_id, (unsigned long)rec.cow_id,
+           (unsigned long)rec.timestamp, rec.volume, rec.ec);
+  return String(buf);
+}
+
+// Запрос досылки из облака: payload — номер since ("123" или {"since":123}).
+// Колбэк вызывается из mqttClient.loop(), то есть в serverMQTTTask
+static void onMqttMessage(String topic, String payload) {
+  if (topic != MQTT_RESYNC_TOPIC) return;
+  const char *p = payload.c_str();
+  while (*p && !isdigit((unsigned char)*p)) p++;
+  mqttResyncSeq = strtoull(p, nullptr, 10);
+  mqttResync    = true;
+  Serial.printf("[ServerMQTT] resync since=%llu\n", (unsigned long long)mqttResyncSeq);
+}
+
 // -----------------------------------------------------------------------------
 // === Функция setup() ===
 void setup() {
@@ -105,6 +155,12 @@ void setup() {
   Serial.begin(115200);
   delay(500);
 
+#ifdef ARCHIVE_BENCH
+  // Сборка-стенд: замер архива на эмуляторе флеша вместо рабочего режима
+  ArchiveBench::report(Serial);
+  while (true) { vTaskDelay(pdMS_TO_TICKS(1000)); }
+#endif
+
   // 2) Монтируем файловую систему (SPIFFS / LittleFS)
 bool fs_ok = LittleFS.begin(/*formatIfFailed=*/ true);
 if (!fs_ok) {
@@ -202,6 +258,13 @@ void startServerMode() {
  mongoose_set_http_handlers("rs485", glue_get_rs485, glue_set_rs485);
  mongoose_set_http_handlers("uchet", glue_get_uchet,  glue_set_uchet);
  mongoose_set_http_handlers("rest",  glue_get_rest,   glue_set_rest);
+ mongoose_set_http_handlers("stats", glue_get_stats,  NULL);  // счётчики архива (только чтение)
+ mongoose_set_http_handlers("archive", glue_reply_archive);   // потоковая выгрузка архива
+ mongoose_set_http_handlers("export", glue_reply_export);     // двоичная выгрузка архива
+ mongoose_set_http_handlers("sync", glue_reply_sync);         // записи после номера since
+ mongoose_set_http_handlers("cow",   glue_reply_cow);         // история коровы
+ mongoose_set_http_handlers("rollup", glue_reply_rollup);     // суточные итоги коровы
+ mongoose_set_http_handlers("consumers", glue_reply_consumers); // курсоры потребителей архива
 
 
  // (при необходимости можно добавить кастомные file/ota/action handlers)
@@ -224,22 +287,36 @@ mongoose_set_http_handlers("ota", glue_get_rest, glue_set_rest);
   //mqttClient.begin(cfgManager.getMQTTServer(), cfgManager.getMQTTPort(), wifiClient);
   //mqttClient.setCredentials(cfgManager.getMQTTUser(), cfgManager.getMQTTPass());
   mqttClient.begin(&wifiClient,cfgManager.getMQTTServer(),cfgManager.getMQTTPort(),cfgManager.getClientID(),cfgManager.getMQTTUser(),cfgManager.getMQTTPass());
+  mqttClient.onMessage(onMqttMessage);
+  mqttClient.subscribe(MQTT_RESYNC_TOPIC);   // подписка повторяется при каждом подключении
   // 7. Инициализация RS485 (подключаем RX/TX/DE)
   pinMode(RS485_DE_PIN, OUTPUT);
   digitalWrite(RS485_DE_PIN, LOW);
   //rs485.begin(RS485_RX_PIN, RS485_TX_PIN, cfgManager.getRS485Baud());
   rs485.begin(RS485_RX_PIN, RS485_TX_PIN,cfgManager.getRS485Baud(),RS485_DE_PIN);
   rs485.setTimeout(100);
+  rs485PollCount = cfgManager.getRS485Clients(rs485PollAddrs, RS485_POLL_MAX);
+  Serial.printf("[ServerRS485] Опрос ПУМ: %u адресов\n", (unsigned)rs485PollCount);
 
   // 8. Инициализация REST (для обновления настроек при ONLINE)
   restClient.begin(cfgManager.getRESTURL());
 
-  // 9. Инициализация архива (SPIFFS) для сервера
-  archiveMgr.begin();
+  // 9. Инициализация архива (журнал сегментов в LittleFS) для сервера
+  archiveMgr.begin(LittleFS, "/archive");
+  // Групповой коммит: пачка из 32 изменений или не реже раза в 2 с
+  archiveMgr.setGroupCommit(32, 2000);
+  // Политика хранения из настроек: возраст, размер, вытеснение pending
+  ArchiveRetention retention;
+  retention.maxAgeDays  = cfgManager.getArchiveMaxAgeDays();
+  retention.maxRecords  = cfgManager.getArchiveMaxRecords();
+  retention.dropPending = cfgManager.getArchiveDropPending();
+  archiveMgr.setRetention(retention);
+  // Повторы, пришедшие после перезагрузки, ловятся по хвосту архива
+  dedupFilter.seed(archiveMgr);
 
 
   otaUpdater = new RS485OTAUpdater(rs485);
-  otaUpdater->begin("/firmware.bin"); // загружаем прошивку из SPIFFS
+  otaInProgress = otaUpdater->begin("/firmware.bin"); // загружаем прошивку из SPIFFS
 
   // Задача для рассылки чанков
   xTaskCreatePinnedToCore(
@@ -247,6 +324,7 @@ mongoose_set_http_handlers("ota", glue_get_rest, glue_set_rest);
       while (otaUpdater->sendNextChunk()) {
         vTaskDelay(pdMS_TO_TICKS(100)); // пауза между чанками
       }
+      otaInProgress = false;            // шина снова для опроса ПУМ
       vTaskDelete(nullptr);
     },
     "ServerOTATask", 4096, nullptr, 2, nullptr, 1
@@ -264,6 +342,17 @@ mongoose_set_http_handlers("ota", glue_get_rest, glue_set_rest);
     0                       // ядро (0 или 1)
   );
 
+  // Задача-писатель архива: создаётся раньше приёма, который её будит
+  xTaskCreatePinnedToCore(
+    serverArchiveTask,
+    "ServerArchiveTask",
+    6144,
+    NULL,
+    1,                      // ниже приёма: флеш не отнимает время у RS485
+    &archiveWriterTask,
+    1
+  );
+
   // Задача для RS485 приёма и архивации
   xTaskCreatePinnedToCore(
     serverRS485Task,
@@ -309,38 +398,133 @@ void serverMongooseTask(void *pvParameters) {
   }
 }
 
+// -----------------------------------------------------------------------------
+// === Проверка повтора записи (Server) ===
+// Сколько последних доений коровы смотреть в архиве, если фильтр не уверен
+#define DEDUP_VERIFY_DEPTH 8
+
+// Вызывается только из ServerArchiveTask (drain()): фильтр трогает одна
+// задача, а сверка с архивом не задерживает приём RS485
+static bool isDuplicateRecord(const ArchiveRecord& r) {
+  bool dup = false;
+  DedupFilter::Verdict verdict = dedupFilter.check(r);
+  switch (verdict) {
+    case DedupFilter::NEW:       break;
+    case DedupFilter::DUPLICATE: dup = true; break;
+    default: {
+      // Редкий случай: совпадение только по фильтру Блума — сверяемся с архивом
+      ArchiveRecord last[DEDUP_VERIFY_DEPTH];
+      size_t n = archiveMgr.lastMilkings(r.cow_id, last, DEDUP_VERIFY_DEPTH);
+      for (size_t i = 0; i < n && !dup; i++) {
+        dup = last[i].client_id == r.client_id && last[i].timestamp == r.timestamp;
+      }
+    }
+  }
+  // Клиент повторяет пакет, если не уверен в доставке — второй раз не пишем.
+  // Повтор уходит из очереди сразу; принятую запись учитывает rememberRecord()
+  if (dup) {
+    dedupFilter.count(verdict);
+    Serial.printf("[ServerArchive] duplicate client=%lu, cow=%lu, ts=%lu\n",
+                  (unsigned long)r.client_id, (unsigned long)r.cow_id, (unsigned long)r.timestamp);
+  }
+  return dup;
+}
+
+// Запись уже в архиве — только теперь её повтор можно отбрасывать.
+// Статистика — здесь, а не в isDuplicateRecord(): запись, которую архив не
+// принял, проверяется на каждом повторе drain()
+static void rememberRecord(const ArchiveRecord& r) {
+  dedupFilter.count(dedupFilter.check(r));
+  dedupFilter.remember(r);
+}
+
 // -----------------------------------------------------------------------------
 // === Задача: приём данных по RS485 и архивирование (Server) ===
+
+// Принять запись ПУМ. false — её надо прислать ещё раз (очередь архива полна)
+static bool acceptRecord(const RS485Packet& pkt) {
+  ArchiveRecord r{pkt.client_id,pkt.cow_id, pkt.timestamp, pkt.liters, pkt.ec, 0};
+  // В архив запись переносит ServerArchiveTask, он же отсеивает повторы:
+  // приём не ждёт ни флеша, ни мьютекса архива
+  if (archiveMgr.enqueue(r)) {
+    xTaskNotifyGive(archiveWriterTask);
+  } else {
+    Serial.println("[ServerRS485] Очередь архива переполнена, запись не принята");
+    return false;
+  }
+  Serial.printf("[ServerRS485] client=%u, cow=%lu, vol=%.2f L, ec=%.2f\n", pkt.client_id,pkt.cow_id, pkt.liters,pkt.ec);
+  // Обновляем счётчик уникальных клиентов и последние данные
+  displayMgr.showMessage("C" + String(pkt.client_id) + " V=" + String(pkt.liters,2) + " EC=" + String(pkt.ec,2) );
+  return true;
+}
+
+// Ждать ответ addr на опрос не дольше waitMs. true — принята запись,
+// её timestamp уходит в ack следующего опроса addr
+static bool pollReply(uint8_t addr, uint32_t waitMs, uint32_t& ackTs) {
+  uint8_t  buf[32];   // ответы короткие, длинные кадры не наши
+  size_t   len;
+  uint32_t start = millis();
+  while (millis() - start < waitMs) {
+    while (rs485.readRaw(buf, len, sizeof(buf))) {
+      RS485Packet pkt;
+      if (len == 2 && buf[0] == RS485_POLL_IDLE && buf[1] == addr) return false;
+      if (RS485Manager::parsePacket(buf, len, pkt) && pkt.client_id == addr) {
+        if (!acceptRecord(pkt)) return false;
+        ackTs = pkt.timestamp;
+        return true;
+      }
+    }
+    vTaskDelay(1);
+  }
+  return false;
+}
+
 void serverRS485Task(void *pvParameters) {
   (void) pvParameters;
+  // Окно ответа: реакция клиента плюс передача кадра ответа (24 байта по 10 бит)
+  const uint32_t replyWait = RS485_POLL_TIMEOUT_MS + 240000UL / cfgManager.getRS485Baud() + 1;
+  bool     acked[RS485_POLL_MAX] = {false};   // есть что подтвердить addr
+  uint32_t ackTs[RS485_POLL_MAX] = {0};
   for (;;) {
-    // Если есть данные в буфере RS485 → читаем пакет
-    if (rs485.available()) {
-    
+    // Адреса не заданы или идёт рассылка OTA: только слушаем шину
+    if (rs485PollCount == 0 || otaInProgress) {
+      // Разбираем всё, что пришло в RS485: readPacket() не ждёт, незаконченный
+      // кадр дособерётся на следующем проходе
       RS485Packet pkt;
-      if (!rs485.readPacket(pkt)) continue;
-    // … обрабатываем pkt
-
-      // Сохраняем «сырую» информацию в архив
-      //archiveMgr.addServerRecord(pkt.client_id, pkt.cow_id, pkt.liters, pkt.timestamp, "pending");
-      /*
-      struct ArchiveRecord {
-    uint32_t   client_id;   // номер ПУМ
-    uint32_t cow_id;
-    uint32_t timestamp;
-    float    volume;
-    float    ec;       // электр.проводимость, мСм/см
-    uint8_t  status; // 0 = pending, 1 = sent, 2 = error
-};
-      */
-      ArchiveRecord r{pkt.client_id,pkt.cow_id, pkt.timestamp, pkt.liters, pkt.ec, 0};
-      archiveMgr.add(r);
-      Serial.printf("[ServerRS485] client=%u, cow=%lu, vol=%.2f L, ec=%.2f\n", pkt.client_id,pkt.cow_id, pkt.liters,pkt.ec);
-      // Обновляем счётчик уникальных клиентов и последние данные
-      displayMgr.showMessage("C" + String(pkt.client_id) + " V=" + String(pkt.liters,2) + " EC=" + String(pkt.ec,2) );
+      while (rs485.readPacket(pkt)) acceptRecord(pkt);
+      vTaskDelay(pdMS_TO_TICKS(100)); // задержка 100 ms
+      continue;
+    }
+
+    // Опрашиваем ПУМ по очереди: передаёт только опрошенный, коллизий нет
+    bool got = false;
+    for (size_t i = 0; i < rs485PollCount; i++) {
+      rs485.sendPoll(rs485PollAddrs[i], acked[i], ackTs[i]);
+      acked[i] = pollReply(rs485PollAddrs[i], replyWait, ackTs[i]);
+      if (acked[i]) got = true;
+    }
+    // Никому нечего передать — не гоняем шину вхолостую
+    if (!got) vTaskDelay(pdMS_TO_TICKS(RS485_POLL_IDLE_MS));
+  }
+}
+
+// -----------------------------------------------------------------------------
+// === Задача: перенос принятых записей в архив (Server) ===
+void serverArchiveTask(void *pvParameters) {
+  (void) pvParameters;
+  for (;;) {
+    // Просыпаемся по уведомлению от приёма или раз в 100 мс для poll()
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    archiveMgr.drain(ARCHIVE_INGEST_QUEUE, isDuplicateRecord, rememberRecord);
+
+    // Сброс буфера архива по таймауту группового коммита
+    archiveMgr.poll();
+
+    // Уплотнение архива — только когда очередь приёма пуста и не чаще COMPACT_INTERVAL
+    if (archiveMgr.ingestBacklog() == 0 && millis() - lastCompact >= COMPACT_INTERVAL) {
+      lastCompact = millis();
+      archiveMgr.compactStep();
     }
- 
-    vTaskDelay(pdMS_TO_TICKS(100)); // задержка 100 ms
   }
 }
 
@@ -350,23 +534,35 @@ void serverMQTTTask(void *pvParameters) {
   (void)pvParameters;
   for (;;) {
     if (serverState == SERVER_ONLINE && wifiConnected) {
+      // Досылка по запросу облака: порция за проход, пока не догоним архив
+      if (mqttResync && mqttClient.isConnected()) {
+        ArchiveRecord recs[MQTT_SYNC_BATCH];
+        uint64_t      seqs[MQTT_SYNC_BATCH];
+        uint64_t      next = mqttResyncSeq;
+        size_t n = archiveMgr.readSince(next, recs, seqs, MQTT_SYNC_BATCH);
+        size_t sent = 0;
+        while (sent < n && mqttClient.publish(MQTT_SYNC_TOPIC, mqttRecordPayload(recs[sent], seqs[sent]))) sent++;
+        // Не ушедшая запись будет первой в следующей порции
+        mqttResyncSeq = sent < n ? seqs[sent] : next;
+        if (n == 0) {
+          char done[96];
+          snprintf(done, sizeof(done), "{\"archive_id\":%lu,\"next\":%llu,\"done\":true}",
+                   (unsigned long)archiveMgr.archiveId(), (unsigned long long)next);
+          mqttResync = !mqttClient.publish(MQTT_SYNC_TOPIC, done);
+        }
+      }
+
       unsigned long now = millis();
       if (now - lastMQTTSend > MQTT_SEND_INTERVAL) {
         lastMQTTSend = now;
 
         ArchiveRecord rec;
-        uint16_t      idx;
+        uint32_t      idx;
         // 1) Ищем первую pending-запись
         if (archiveMgr.getNextPending(idx, rec)) {
           // 2) Формируем MQTT-топик и JSON с клиентом и ec
           String topic = "milk/pum/" + String(rec.client_id) + "/record";
-          String payload = String("{")
-            + "\"pum_id\":"   + String(rec.client_id)    + ","
-            + "\"cow_id\":"   + String(rec.cow_id)       + ","
-            + "\"timestamp\":" + String(rec.timestamp)   + ","
-            + "\"volume\":"    + String(rec.volume,2)    + ","
-            + "\"ec\":"        + String(rec.ec,2)
-            + "}";
+          String payload = mqttRecordPayload(rec, archiveMgr.seqOf(idx));
 
           // 3) Проверяем соединение
           if (!mqttClient.isConnected()) {
@@ -376,12 +572,38 @@ void serverMQTTTask(void *pvParameters) {
           // 4) Публикуем и помечаем
           if (mqttClient.publish(topic, payload)) {
             archiveMgr.updateStatus(idx, /*1=*/1);
-            Serial.printf("[ServerMQTT] sent idx=%u pum=%u\n",
-                          idx, rec.client_id);
+            Serial.printf("[ServerMQTT] sent idx=%lu pum=%u\n",
+                          (unsigned long)idx, rec.client_id);
           } else {
-            Serial.printf("[ServerMQTT] fail idx=%u\n", idx);
+            Serial.printf("[ServerMQTT] fail idx=%lu\n", (unsigned long)idx);
           }
         }
+
+        // 5) Телеметрия архива: счётчики берутся из RAM
+        ArchiveCounters cnt = archiveMgr.counters();
+        ArchiveFlushStats fl = archiveMgr.flushStats();
+        String stats = String("{")
+          + "\"total\":"   + String(cnt.total)   + ","
+          + "\"pending\":" + String(cnt.pending) + ","
+          + "\"sent\":"    + String(cnt.sent)    + ","
+          + "\"error\":"   + String(cnt.error)   + ","
+          + "\"duplicates\":" + String(dedupFilter.stats().duplicates) + ","
+          + "\"ingest_dropped\":" + String(archiveMgr.ingestDropped()) + ","
+          + "\"flush_us\":"     + String(fl.last_us) + ","
+          + "\"flush_max_us\":" + String(fl.max_us) + ","
+          + "\"reclaimed\":"    + String(archiveMgr.compactStats().bytes) + ","
+          + "\"compact_us\":"   + String(archiveMgr.compactStats().total_us) + ","
+          + "\"overflow\":"     + String(archiveMgr.retentionStats().overflow) + ","
+          + "\"rejected\":"     + String(archiveMgr.retentionStats().rejected) + ","
+          + "\"cache_hit_pct\":" + String(archiveMgr.cacheStats().hitPercent()) + ","
+          + "\"lag\":{";
+        // Отставание каждого потребителя архива с собственным курсором
+        for (uint8_t i = 0; i < archiveMgr.consumerCount(); i++) {
+          if (i) stats += ",";
+          stats += "\"" + String(archiveMgr.consumerName(i)) + "\":" + String(archiveMgr.consumerLag(i));
+        }
+        stats += "}}";
+        mqttClient.publish("milk/server/archive", stats);
       }
       mqttClient.loop();
     }
@@ -408,6 +630,9 @@ void startClientMode() {
   cfgManager.begin("milk_cfg");
   if (!cfgManager.hasSavedClientID()) {
     Serial.println("[Client] RS485 Client ID не найден. Нужно настроить в веб-конфиге или вручную.");
+  } else if (cfgManager.getRS485Addr() == 0) {
+    Serial.printf("[Client] RS485 Client ID \"%s\" — не адрес 1..255, опрос сервера не обслуживается\n",
+                  cfgManager.getClientID().c_str());
   }
 
   // 2. Инициализация дисплея
@@ -428,8 +653,9 @@ void startClientMode() {
   otaReceiver = new OTAReceiver(rs485);
   rs485.setTimeout(100);
 
-  // 6. Инициализация архива (SPIFFS) для клиента
-  archiveMgr.begin();
+  // 6. Инициализация архива (журнал сегментов в LittleFS) для клиента
+  archiveMgr.begin(LittleFS, "/archive");
+  archiveMgr.setGroupCommit(32, 2000);
 
   // 7. Стартовый экран в клиенте
  // displayMgr.showClientStatus("Idle");
@@ -632,23 +858,93 @@ void clientRS485Task(void *pvParameters) {
 }
   */
 
+  // Последняя запись, отправленная в ответ на опрос: подтверждение
+  // сверяется с ней по (client_id, timestamp)
+  struct PollSent {
+    bool     valid;
+    uint8_t  client_id;
+    uint32_t timestamp;
+  };
+  static PollSent pollSent = {false, 0, 0};
+
+  // Ответ на опрос сервера: подтверждённую запись помечаем sent,
+  // в ответ — следующая pending-запись или «данных нет»
+  static void answerPoll(uint8_t addr, bool ack, uint32_t ackTs) {
+    uint32_t idx;
+    ArchiveRecord rec;
+    if (ack && pollSent.valid && pollSent.client_id == addr && pollSent.timestamp == ackTs
+        && archiveMgr.getNextPending(idx, rec) && rec.timestamp == ackTs) {
+      archiveMgr.updateStatus(idx, /*1=*/1);
+      Serial.printf("[ClientRS485] Sent idx=%lu cow=%lu\n",
+                    (unsigned long)idx, rec.cow_id);
+    }
+    pollSent.valid = false;
+    if (!archiveMgr.getNextPending(idx, rec)) {
+      rs485.sendPollIdle(addr);
+      return;
+    }
+    RS485Packet pkt;
+    pkt.client_id = addr;
+    pkt.cow_id    = rec.cow_id;
+    pkt.liters    = rec.volume;
+    pkt.timestamp = rec.timestamp;
+    pkt.ec        = rec.ec;
+    if (rs485.sendPacket(pkt)) pollSent = {true, addr, rec.timestamp};
+  }
+
   void clientRS485Task(void *pvParameters) {
     (void)pvParameters;
-  
+    // 0 — Client ID не адрес шины: не отвечаем на опросы и не передаём сами
+    const uint8_t myAddr     = cfgManager.getRS485Addr();
+    bool          polled     = false;   // сервер опрашивает шину
+    unsigned long lastPoll   = 0;
+    unsigned long lastSend   = 0;
+
     for (;;) {
-      // 1) Сначала обработка OTA (если придут пакеты прошивки)
-      otaReceiver->handle();
-  
+      // 1) Разбираем пришедшие кадры: опросы сервера и OTA
+      uint8_t buf[RS485_MAX_PAYLOAD];
+      size_t  len;
+      while (rs485.readRaw(buf, len, sizeof(buf))) {
+        uint8_t  addr;
+        bool     ack;
+        uint32_t ackTs;
+        if (RS485Manager::parsePoll(buf, len, addr, ack, ackTs)) {
+          // Молчим, только если сервер опрашивает именно нас: ПУМ, которого
+          // нет в списке опроса, иначе никогда не передал бы свои записи
+          if (myAddr && addr == myAddr) {
+            polled   = true;
+            lastPoll = millis();
+            answerPoll(addr, ack, ackTs);
+          }
+        } else {
+          otaReceiver->processPayload(buf, len);
+        }
+      }
+      if (polled && millis() - lastPoll > RS485_MASTER_SILENCE_MS) polled = false;
+
       // 2) Если нужно отправлять
       if (clientState == CLIENT_MEASURING || clientState == CLIENT_SENDING) {
-        if (rs485.isConnected()) {
+        if (polled) {
+          // Запись уже в архиве, её заберёт опрос сервера
+          clientState = CLIENT_IDLE;
+        } else if (millis() - lastSend < 500) {
+          // Сервер не опрашивает — передаём сами, не чаще раза в 500 мс
+        } else if (!myAddr) {
+          // Client ID не адрес шины: с client_id = 0 сервер не отличит нас
+          // от других ПУМ — не передаём, записи ждут в архиве
+          Serial.printf("[ClientRS485] Client ID \"%s\" не адрес шины (1..255), передача пропущена\n",
+                        cfgManager.getClientID().c_str());
+          lastSend    = millis();
+          clientState = CLIENT_IDLE;
+        } else if (rs485.isConnected()) {
+          lastSend = millis();
           // 2.1) Ищем первую pending-запись
-          uint16_t idx;
+          uint32_t idx;
           ArchiveRecord rec;
           if (archiveMgr.getNextPending(idx, rec)) {
             // 2.2) Формируем пакет
             RS485Packet pkt;
-            pkt.client_id = (uint32_t)cfgManager.getClientID().toInt(); 
+            pkt.client_id = myAddr;
             pkt.cow_id    = rec.cow_id;
             pkt.liters    = rec.volume;
             pkt.timestamp = rec.timestamp;
@@ -658,10 +954,10 @@ void clientRS485Task(void *pvParameters) {
             if (rs485.sendPacket(pkt)) {
               // 2.4) Помечаем как sent
               archiveMgr.updateStatus(idx, /*1=*/1);
-              Serial.printf("[ClientRS485] Sent idx=%u cow=%lu\n",
-                            idx, rec.cow_id);
+              Serial.printf("[ClientRS485] Sent idx=%lu cow=%lu\n",
+                            (unsigned long)idx, rec.cow_id);
             } else {
-              Serial.printf("[ClientRS485] Fail to send idx=%u\n", idx);
+              Serial.printf("[ClientRS485] Fail to send idx=%lu\n", (unsigned long)idx);
             }
           }
           // вернёмся в idle
@@ -673,8 +969,11 @@ void clientRS485Task(void *pvParameters) {
         }
       }
   
-      // 3) Небольшая пауза
-      vTaskDelay(pdMS_TO_TICKS(500));
+      // 3) Сброс буфера архива по таймауту группового коммита
+      archiveMgr.poll();
+
+      // 4) Короткая пауза: на опрос сервер ждёт ответа RS485_POLL_TIMEOUT_MS
+      vTaskDelay(pdMS_TO_TICKS(5));
     }
   }
 // -----------------------------------------------------------------------------
@@ -707,20 +1006,12 @@ void clientRS485Task(void *pvParameters) {
 void clientDisplayTask(void *pvParameters) {
   (void) pvParameters;
   for (;;) {
-    // 1) Считаем количество pending-записей в архиве
-    uint16_t pendingCount = 0;
-    ArchiveRecord rec;
-    uint16_t    idx;
-
-    // правильно: передаём два аргумента — индекс и запись
-    while (archiveMgr.getNextPending(idx, rec)) {
-      pendingCount++;
-    }
+    // 1) Количество pending-записей — готовый счётчик архива, без чтения флеша
+    uint32_t pendingCount = archiveMgr.pendingCount();
 
     // 2) Показываем на экране: кол-во записей в ожидании, последний ID и объём
-    // Клиентский счётчик — uint8_t, поэтому можно привести:
     displayMgr.showClientStatus(
-      /*clientCount=*/ (uint8_t)pendingCount,
+      /*pendingCount=*/ (uint16_t)(pendingCount > UINT16_MAX ? UINT16_MAX : pendingCount),
       /*lastCowId=*/   lastCowID,
       /*lastVolume=*/  lastVolume
     );
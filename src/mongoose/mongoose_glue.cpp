@@ -80,10 +80,12 @@ void glue_set_rest(struct rest *data) {
 #endif
 #include "mongoose_glue.h"
 #include "../src/utils/ConfigManager.h"  
+#include "../src/utils/ArchiveManager.h"
   
  
  
 extern ConfigManager cfgManager; 
+extern ArchiveManager archiveMgr;
 
 void glue_get_wifi(struct wifi *data) {
   cfgManager.getWiFiCredentials();
@@ -148,3 +150,317 @@ void glue_set_rest(struct rest *data) {
   cfgManager.commit();
   glue_update_state();
 }
+
+void glue_get_stats(struct stats *data) {
+  ArchiveCounters cnt = archiveMgr.counters();
+  data->total   = (int)cnt.total;
+  data->pending = (int)cnt.pending;
+  data->sent    = (int)cnt.sent;
+  data->error   = (int)cnt.error;
+  ArchiveFlushStats fl = archiveMgr.flushStats();
+  data->flush_us     = (int)fl.last_us;
+  data->flush_max_us = (int)fl.max_us;
+  ArchiveCacheStats cs = archiveMgr.cacheStats();
+  data->cache_hits    = (int)cs.hits;
+  data->cache_misses  = (int)cs.misses;
+  data->cache_hit_pct = (int)cs.hitPercent();
+  ArchiveRetentionStats rs = archiveMgr.retentionStats();
+  data->expired  = (int)rs.expired;
+  data->overflow = (int)rs.overflow;
+  data->rejected = (int)rs.rejected;
+}
+
+void glue_get_retention(struct retention *data) {
+  data->max_age_days = (int)cfgManager.getArchiveMaxAgeDays();
+  data->max_records  = (int)cfgManager.getArchiveMaxRecords();
+  data->drop_pending = cfgManager.getArchiveDropPending();
+}
+
+void glue_set_retention(struct retention *data) {
+  ArchiveRetention policy;
+  policy.maxAgeDays  = data->max_age_days > 0 ? (uint32_t)data->max_age_days : 0;
+  policy.maxRecords  = data->max_records > 0 ? (uint32_t)data->max_records : 0;
+  policy.dropPending = data->drop_pending;
+  cfgManager.saveArchiveRetention(policy.maxAgeDays, policy.maxRecords, policy.dropPending);
+  cfgManager.commit();
+  archiveMgr.setRetention(policy);  // лишнее уйдёт при следующих шагах уплотнения
+}
+
+// Размер одной порции потоковой выгрузки архива
+#define ARCHIVE_STREAM_CHUNK 512
+
+// Состояние выгрузки архива, хранится в c->data (MG_DATA_SIZE байт)
+struct archive_stream {
+  char marker;           // 'X' — архив в JSON, 'B' — двоичная выгрузка
+  bool first;            // ещё не выведено ни одной записи
+  uint32_t cursor;       // глобальный индекс следующей записи
+  ArchiveFilter filter;  // какие записи отдавать
+};
+static_assert(sizeof(struct archive_stream) <= MG_DATA_SIZE, "archive_stream не влезает в c->data");
+
+static void archive_stream_handler(struct mg_connection *c, int ev, void *ev_data) {
+  struct archive_stream *as = (struct archive_stream *) c->data;
+  (void) ev_data;
+  if (as->marker != 'X' || (ev != MG_EV_POLL && ev != MG_EV_WRITE)) return;
+  // Новую порцию готовим, только когда сокет забрал предыдущую:
+  // в очереди на отправку не больше одного чанка
+  if (c->send.len >= ARCHIVE_STREAM_CHUNK) return;
+
+  static char buf[ARCHIVE_STREAM_CHUNK];  // Mongoose крутится в одной задаче
+  size_t n = archiveMgr.exportJson(as->cursor, buf, sizeof(buf), as->first, as->filter);
+  if (n > 0) mg_http_write_chunk(c, buf, n);
+  if (as->cursor >= archiveMgr.endIndex()) {
+    mg_http_write_chunk(c, "]", 1);
+    mg_http_write_chunk(c, "", 0);  // завершающий пустой чанк
+    as->marker = 0;
+    c->is_draining = 1;             // закрыть соединение после отправки
+  }
+}
+
+// Числовой параметр запроса (?name=123) или def, если его нет
+static uint32_t query_uint(struct mg_http_message *hm, const char *name, uint32_t def) {
+  char buf[16];
+  if (mg_http_get_var(&hm->query, name, buf, sizeof(buf)) <= 0) return def;
+  return (uint32_t) strtoul(buf, NULL, 10);
+}
+
+// Отправить заголовки и "[", дальше записи порциями из archive_stream_handler.
+// X-Archive-End — индекс, до которого выгрузка гарантированно дойдёт
+static void start_archive_stream(struct mg_connection *c, const ArchiveFilter &filter,
+                                 uint32_t cursor) {
+  struct archive_stream *as = (struct archive_stream *) c->data;
+  mg_printf(c, "HTTP/1.1 200 OK\r\n"
+               "Content-Type: application/json\r\n"
+               "X-Archive-End: %lu\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n",
+            (unsigned long) archiveMgr.endIndex());
+  mg_http_write_chunk(c, "[", 1);
+  *as = archive_stream();
+  as->marker = 'X';
+  as->first  = true;
+  as->cursor = cursor;
+  as->filter = filter;
+  c->fn  = archive_stream_handler;  // Дальше события идут в потоковый обработчик
+  c->pfn = NULL;                    // HTTP-парсер больше не нужен
+  archive_stream_handler(c, MG_EV_POLL, NULL);
+}
+
+// GET /api/archive[?from=<unix>&to=<unix>&cow=<id>&client=<id>&status=<n>&consumer=<name>] —
+// записи с timestamp в [from, to]; с consumer — только ещё не доставленные этому потребителю.
+// Потребителя заводит POST /api/consumers, выгрузка его курсор не двигает
+void glue_reply_archive(struct mg_connection *c, struct mg_http_message *hm) {
+  ArchiveFilter filter;
+  filter.from      = query_uint(hm, "from", 0);
+  filter.to        = query_uint(hm, "to", UINT32_MAX);
+  filter.cow_id    = query_uint(hm, "cow", ArchiveFilter::ANY_COW);
+  filter.client_id = query_uint(hm, "client", ArchiveFilter::ANY_CLIENT);
+  filter.status    = (uint8_t) query_uint(hm, "status", ArchiveFilter::ANY_STATUS);
+  uint32_t cursor = archiveMgr.firstIndex();
+  char name[ArchiveManager::CONSUMER_NAME_MAX + 1];
+  if (mg_http_get_var(&hm->query, "consumer", name, sizeof(name)) > 0) {
+    int8_t id = archiveMgr.findConsumer(name);
+    if (id < 0) {
+      mg_http_reply(c, 404, "", "unknown consumer\n");
+      return;
+    }
+    cursor = archiveMgr.consumerCursor((uint8_t) id);
+  }
+  start_archive_stream(c, filter, cursor);
+}
+
+// Размер одной порции двоичной выгрузки (блок из ~40 записей)
+#define EXPORT_STREAM_CHUNK 1024
+
+static void export_stream_handler(struct mg_connection *c, int ev, void *ev_data) {
+  struct archive_stream *as = (struct archive_stream *) c->data;
+  (void) ev_data;
+  if (as->marker != 'B' || (ev != MG_EV_POLL && ev != MG_EV_WRITE)) return;
+  if (c->send.len >= EXPORT_STREAM_CHUNK) return;
+
+  static uint8_t buf[EXPORT_STREAM_CHUNK];  // Mongoose крутится в одной задаче
+  size_t n = archiveMgr.exportBinary(as->cursor, buf, sizeof(buf), as->filter);
+  if (n > 0) {
+    mg_http_write_chunk(c, (const char *) buf, n);
+  } else {  // записи кончились
+    n = ArchiveManager::exportBinaryTrailer(buf, as->cursor);
+    mg_http_write_chunk(c, (const char *) buf, n);
+    mg_http_write_chunk(c, "", 0);  // завершающий пустой чанк
+    as->marker = 0;
+    c->is_draining = 1;
+  }
+}
+
+// GET /api/export[?since=<index>&from=&to=&cow=&client=&status=] — те же записи,
+// что /api/archive, в двоичном формате ArchiveManager::exportBinaryHeader():
+// 25 байт на запись вместо ~100 байт JSON. since — продолжить с этого индекса
+void glue_reply_export(struct mg_connection *c, struct mg_http_message *hm) {
+  struct archive_stream *as = (struct archive_stream *) c->data;
+  *as = archive_stream();
+  as->filter.from      = query_uint(hm, "from", 0);
+  as->filter.to        = query_uint(hm, "to", UINT32_MAX);
+  as->filter.cow_id    = query_uint(hm, "cow", ArchiveFilter::ANY_COW);
+  as->filter.client_id = query_uint(hm, "client", ArchiveFilter::ANY_CLIENT);
+  as->filter.status    = (uint8_t) query_uint(hm, "status", ArchiveFilter::ANY_STATUS);
+  as->cursor = query_uint(hm, "since", 0);
+  if (as->cursor < archiveMgr.firstIndex()) as->cursor = archiveMgr.firstIndex();
+
+  uint32_t end = archiveMgr.endIndex();
+  mg_printf(c, "HTTP/1.1 200 OK\r\n"
+               "Content-Type: application/octet-stream\r\n"
+               "X-Archive-End: %lu\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n",
+            (unsigned long) end);
+  uint8_t hdr[ArchiveManager::EXPORT_HEADER_SIZE];
+  size_t n = ArchiveManager::exportBinaryHeader(hdr, as->cursor, end);
+  mg_http_write_chunk(c, (const char *) hdr, n);
+  as->marker = 'B';
+  c->fn  = export_stream_handler;
+  c->pfn = NULL;
+  export_stream_handler(c, MG_EV_POLL, NULL);
+}
+
+// Сколько записей отдаёт /api/sync за один запрос
+#define SYNC_MAX 64
+
+// GET /api/sync?since=<seq>[&max=N] — записи, которых у получателя ещё нет
+// (ArchiveManager::readSince()); next — since для следующего запроса
+void glue_reply_sync(struct mg_connection *c, struct mg_http_message *hm) {
+  char var[24];
+  uint64_t seq = mg_http_get_var(&hm->query, "since", var, sizeof(var)) > 0 ? strtoull(var, NULL, 10) : 0;
+  uint32_t max = query_uint(hm, "max", SYNC_MAX);
+  if (max == 0 || max > SYNC_MAX) max = SYNC_MAX;
+
+  static ArchiveRecord recs[SYNC_MAX];  // Mongoose крутится в одной задаче
+  static uint64_t seqs[SYNC_MAX];
+  size_t n = archiveMgr.readSince(seq, recs, seqs, max);
+
+  mg_printf(c, "HTTP/1.1 200 OK\r\n"
+               "Content-Type: application/json\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n");
+  mg_http_printf_chunk(c, "{\"archive_id\":%lu,\"next\":%llu,\"records\":[",
+                       (unsigned long) archiveMgr.archiveId(), (unsigned long long) seq);
+  for (size_t i = 0; i < n; i++) {
+    char buf[ArchiveManager::EXPORT_JSON_MAX];
+    int len = ArchiveManager::recordJson(recs[i], buf, sizeof(buf));
+    if (len <= 1 || (size_t) len >= sizeof(buf)) continue;
+    // {"seq":N, + поля записи без открывающей скобки
+    mg_http_printf_chunk(c, "%s{\"seq\":%llu,%s", i ? "," : "", (unsigned long long) seqs[i], buf + 1);
+  }
+  mg_http_printf_chunk(c, "]}");
+  mg_http_write_chunk(c, "", 0);
+}
+
+// Сколько последних доений отдаёт /api/cow?last=N за раз
+#define COW_LAST_MAX 32
+
+// GET /api/cow?id=<cow_id>[&last=N] — история коровы или N последних доений
+void glue_reply_cow(struct mg_connection *c, struct mg_http_message *hm) {
+  uint32_t cow = query_uint(hm, "id", ArchiveFilter::ANY_COW);
+  if (cow == ArchiveFilter::ANY_COW) {
+    mg_http_reply(c, 400, "", "id required\n");
+    return;
+  }
+  uint32_t last = query_uint(hm, "last", 0);
+  if (last == 0) {
+    ArchiveFilter filter;
+    filter.cow_id = cow;
+    start_archive_stream(c, filter, archiveMgr.firstIndex());
+    return;
+  }
+
+  if (last > COW_LAST_MAX) last = COW_LAST_MAX;
+  ArchiveRecord recs[COW_LAST_MAX];
+  size_t n = archiveMgr.lastMilkings(cow, recs, last);
+  mg_printf(c, "HTTP/1.1 200 OK\r\n"
+               "Content-Type: application/json\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n");
+  mg_http_write_chunk(c, "[", 1);
+  for (size_t i = 0; i < n; i++) {
+    char buf[ArchiveManager::EXPORT_JSON_MAX];
+    int len = ArchiveManager::recordJson(recs[i], buf, sizeof(buf));
+    if (i > 0) mg_http_write_chunk(c, ",", 1);
+    if (len > 0 && (size_t) len < sizeof(buf)) mg_http_write_chunk(c, buf, (size_t) len);
+  }
+  mg_http_write_chunk(c, "]", 1);
+  mg_http_write_chunk(c, "", 0);
+}
+
+// Самый длинный период /api/rollup по умолчанию, суток
+#define ROLLUP_DEFAULT_DAYS 31
+
+// GET /api/rollup?cow=<id>[&from=<unix>&to=<unix>] — суточные итоги коровы и сумма за период
+void glue_reply_rollup(struct mg_connection *c, struct mg_http_message *hm) {
+  uint32_t cow = query_uint(hm, "cow", ArchiveFilter::ANY_COW);
+  if (cow == ArchiveFilter::ANY_COW) {
+    mg_http_reply(c, 400, "", "cow required\n");
+    return;
+  }
+  uint32_t to   = RollupStore::dayOf(query_uint(hm, "to", (uint32_t) time(NULL)));
+  uint32_t from = query_uint(hm, "from", 0);
+  from = from ? RollupStore::dayOf(from) : (to >= ROLLUP_DEFAULT_DAYS ? to - ROLLUP_DEFAULT_DAYS + 1 : 0);
+
+  mg_printf(c, "HTTP/1.1 200 OK\r\n"
+               "Content-Type: application/json\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n");
+  mg_http_printf_chunk(c, "{\"cow_id\":%lu,\"days\":[", (unsigned long) cow);
+  bool first = true;
+  RollupRow total = archiveMgr.rollupRange(cow, from, to, [&](uint32_t day, const RollupRow &r) {
+    mg_http_printf_chunk(c, "%s{\"day\":%lu,\"sessions\":%u,\"volume\":%.2f,"
+                            "\"ec_min\":%.2f,\"ec_max\":%.2f,\"ec_mean\":%.2f}",
+                         first ? "" : ",", (unsigned long) day, r.sessions, r.volume,
+                         r.ec_min, r.ec_max, r.ecMean());
+    first = false;
+    return true;
+  });
+  mg_http_printf_chunk(c, "],\"sessions\":%u,\"volume\":%.2f,\"ec_min\":%.2f,"
+                          "\"ec_max\":%.2f,\"ec_mean\":%.2f}",
+                       total.sessions, total.volume, total.ec_min, total.ec_max, total.ecMean());
+  mg_http_write_chunk(c, "", 0);
+}
+
+// GET /api/consumers — курсоры потребителей архива и их отставание, ничего не меняет.
+// POST /api/consumers?name=<name>[&ack=<end>] — завести потребителя (мест
+// ArchiveManager::MAX_CONSUMERS), с ack — подтвердить доставку записей с индексом < end.
+// DELETE /api/consumers?name=<name> — удалить потребителя, освободив место
+void glue_reply_consumers(struct mg_connection *c, struct mg_http_message *hm) {
+  bool post = mg_strcmp(hm->method, mg_str("POST")) == 0;
+  bool del  = mg_strcmp(hm->method, mg_str("DELETE")) == 0;
+  if (post || del) {
+    char name[ArchiveManager::CONSUMER_NAME_MAX + 1];
+    if (mg_http_get_var(&hm->query, "name", name, sizeof(name)) <= 0) {
+      mg_http_reply(c, 400, "", "name required\n");
+      return;
+    }
+    if (del) {
+      if (!archiveMgr.closeConsumer(name)) {
+        mg_http_reply(c, 404, "", "unknown consumer\n");
+        return;
+      }
+    } else {
+      int8_t id = archiveMgr.openConsumer(name);
+      if (id < 0 && archiveMgr.consumerCount() < ArchiveManager::MAX_CONSUMERS) {
+        mg_http_reply(c, 400, "", "bad consumer name\n");
+        return;
+      }
+      if (id < 0) {
+        mg_http_reply(c, 507, "", "too many consumers\n");
+        return;
+      }
+      uint32_t end = query_uint(hm, "ack", 0);
+      if (end) archiveMgr.consumerAck((uint8_t) id, end);
+    }
+  }
+
+  mg_printf(c, "HTTP/1.1 200 OK\r\n"
+               "Content-Type: application/json\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n");
+  mg_http_printf_chunk(c, "{\"end\":%lu,\"consumers\":[", (unsigned long) archiveMgr.endIndex());
+  for (uint8_t i = 0; i < archiveMgr.consumerCount(); i++) {
+    mg_http_printf_chunk(c, "%s{\"name\":\"%s\",\"cursor\":%lu,\"lag\":%lu}",
+                         i ? "," : "", archiveMgr.consumerName(i),
+                         (unsigned long) archiveMgr.consumerCursor(i),
+                         (unsigned long) archiveMgr.consumerLag(i));
+  }
+  mg_http_printf_chunk(c, "]}");
+  mg_http_write_chunk(c, "", 0);
+}
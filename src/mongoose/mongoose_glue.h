@@ -112,6 +112,37 @@ struct rest {
 void glue_get_rest(struct rest *);
 void glue_set_rest(struct rest *);
 
+struct stats {
+  int total;
+  int pending;
+  int sent;
+  int error;
+  int flush_us;
+  int flush_max_us;
+  int cache_hits;
+  int cache_misses;
+  int cache_hit_pct;
+  int expired;
+  int overflow;
+  int rejected;
+};
+void glue_get_stats(struct stats *);
+
+struct retention {
+  int max_age_days;
+  int max_records;
+  bool drop_pending;
+};
+void glue_get_retention(struct retention *);
+void glue_set_retention(struct retention *);
+
+void glue_reply_archive(struct mg_connection *, struct mg_http_message *);
+void glue_reply_export(struct mg_connection *, struct mg_http_message *);
+void glue_reply_sync(struct mg_connection *, struct mg_http_message *);
+void glue_reply_cow(struct mg_connection *, struct mg_http_message *);
+void glue_reply_rollup(struct mg_connection *, struct mg_http_message *);
+void glue_reply_consumers(struct mg_connection *, struct mg_http_message *);
+
 
 #ifdef __cplusplus
 }
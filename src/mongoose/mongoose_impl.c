@@ -151,19 +151,56 @@ static struct attribute s_rest_attributes[] = {
   {"url", "string", NULL, offsetof(struct rest, url), 100, false},
   {NULL, NULL, NULL, 0, 0, false}
 };
+static struct attribute s_stats_attributes[] = {
+  {"total", "int", NULL, offsetof(struct stats, total), 0, true},
+  {"pending", "int", NULL, offsetof(struct stats, pending), 0, true},
+  {"sent", "int", NULL, offsetof(struct stats, sent), 0, true},
+  {"error", "int", NULL, offsetof(struct stats, error), 0, true},
+  {"flush_us", "int", NULL, offsetof(struct stats, flush_us), 0, true},
+  {"flush_max_us", "int", NULL, offsetof(struct stats, flush_max_us), 0, true},
+  {"cache_hits", "int", NULL, offsetof(struct stats, cache_hits), 0, true},
+  {"cache_misses", "int", NULL, offsetof(struct stats, cache_misses), 0, true},
+  {"cache_hit_pct", "int", NULL, offsetof(struct stats, cache_hit_pct), 0, true},
+  {"expired", "int", NULL, offsetof(struct stats, expired), 0, true},
+  {"overflow", "int", NULL, offsetof(struct stats, overflow), 0, true},
+  {"rejected", "int", NULL, offsetof(struct stats, rejected), 0, true},
+  {NULL, NULL, NULL, 0, 0, false}
+};
+static struct attribute s_retention_attributes[] = {
+  {"max_age_days", "int", NULL, offsetof(struct retention, max_age_days), 0, false},
+  {"max_records", "int", NULL, offsetof(struct retention, max_records), 0, false},
+  {"drop_pending", "bool", NULL, offsetof(struct retention, drop_pending), 0, false},
+  {NULL, NULL, NULL, 0, 0, false}
+};
 
 static struct apihandler_data s_apihandler_wifi = {{"wifi", "data", false, 0, 0, 0UL}, s_wifi_attributes, sizeof(struct wifi), (void (*)(void *)) glue_get_wifi, (void (*)(void *)) glue_set_wifi};
 static struct apihandler_data s_apihandler_mqtt = {{"mqtt", "data", false, 0, 0, 0UL}, s_mqtt_attributes, sizeof(struct mqtt), (void (*)(void *)) glue_get_mqtt, (void (*)(void *)) glue_set_mqtt};
 static struct apihandler_data s_apihandler_rs485 = {{"rs485", "data", false, 0, 0, 0UL}, s_rs485_attributes, sizeof(struct rs485), (void (*)(void *)) glue_get_rs485, (void (*)(void *)) glue_set_rs485};
 static struct apihandler_data s_apihandler_uchet = {{"uchet", "data", false, 0, 0, 0UL}, s_uchet_attributes, sizeof(struct uchet), (void (*)(void *)) glue_get_uchet, (void (*)(void *)) glue_set_uchet};
 static struct apihandler_data s_apihandler_rest = {{"rest", "data", false, 0, 0, 0UL}, s_rest_attributes, sizeof(struct rest), (void (*)(void *)) glue_get_rest, (void (*)(void *)) glue_set_rest};
+static struct apihandler_data s_apihandler_stats = {{"stats", "data", true, 0, 0, 0UL}, s_stats_attributes, sizeof(struct stats), (void (*)(void *)) glue_get_stats, NULL};
+static struct apihandler_data s_apihandler_retention = {{"retention", "data", false, 0, 0, 0UL}, s_retention_attributes, sizeof(struct retention), (void (*)(void *)) glue_get_retention, (void (*)(void *)) glue_set_retention};
+static struct apihandler_custom s_apihandler_archive = {{"archive", "custom", true, 0, 0, 0UL}, glue_reply_archive};
+static struct apihandler_custom s_apihandler_export = {{"export", "custom", true, 0, 0, 0UL}, glue_reply_export};
+static struct apihandler_custom s_apihandler_sync = {{"sync", "custom", true, 0, 0, 0UL}, glue_reply_sync};
+static struct apihandler_custom s_apihandler_cow = {{"cow", "custom", true, 0, 0, 0UL}, glue_reply_cow};
+static struct apihandler_custom s_apihandler_rollup = {{"rollup", "custom", true, 0, 0, 0UL}, glue_reply_rollup};
+static struct apihandler_custom s_apihandler_consumers = {{"consumers", "custom", false, 0, 0, 0UL}, glue_reply_consumers};
 
 static struct apihandler *s_apihandlers[] = {
   (struct apihandler *) &s_apihandler_wifi,
   (struct apihandler *) &s_apihandler_mqtt,
   (struct apihandler *) &s_apihandler_rs485,
   (struct apihandler *) &s_apihandler_uchet,
-  (struct apihandler *) &s_apihandler_rest
+  (struct apihandler *) &s_apihandler_rest,
+  (struct apihandler *) &s_apihandler_stats,
+  (struct apihandler *) &s_apihandler_retention,
+  (struct apihandler *) &s_apihandler_archive,
+  (struct apihandler *) &s_apihandler_export,
+  (struct apihandler *) &s_apihandler_sync,
+  (struct apihandler *) &s_apihandler_cow,
+  (struct apihandler *) &s_apihandler_rollup,
+  (struct apihandler *) &s_apihandler_consumers
 };
 
 static struct apihandler *get_api_handler(struct mg_str name) {
@@ -0,0 +1,118 @@
+#include "ArchiveBench.h"
+#include "ArchiveManager.h"
+#include "FlashEmulator.h"
+#include <new>
+
+// Групповой коммит рабочего режима (см. startServerMode())
+static const uint16_t BENCH_GROUP_RECORDS = 32;
+// Записей, добавленных после отправки и потерянных «сбоем питания»
+static const uint32_t BENCH_TAIL_RECORDS  = 100;
+
+// Такты ЦП в мкс; разность тактов в uint32_t верна для интервалов до ~17 с (240 МГц)
+static float cyclesToUs(uint64_t cycles) {
+    return (float)cycles / ESP.getCpuFreqMHz();
+}
+
+static ArchiveRecord benchRecord(uint32_t i) {
+    ArchiveRecord r;
+    r.client_id = 1 + i % 8;
+    r.cow_id    = 1000 + i % 500;
+    r.timestamp = 1700000000UL + i * 60;
+    r.volume    = 8.0f + (i % 40) * 0.25f;
+    r.ec        = 4.5f + (i % 10) * 0.1f;
+    r.status    = 0;
+    return r;
+}
+
+ArchiveBenchResult ArchiveBench::run(uint32_t records) {
+    ArchiveBenchResult res;
+    memset(&res, 0, sizeof(res));
+    uint32_t limit = ArchiveManager::MAX_RECORDS - ArchiveManager::SEGMENT_RECORDS - BENCH_TAIL_RECORDS;
+    if (records > limit) records = limit;
+    res.records = records;
+
+    FlashEmulator flash;
+    ArchiveManager* archive = new (std::nothrow) ArchiveManager();
+    if (!archive) return res;
+    res.ok = archive->begin(flash, "/archive");
+    archive->setGroupCommit(BENCH_GROUP_RECORDS, 0);
+
+    // 1) Добавление
+    flash.resetStats();
+    uint64_t total = 0;
+    uint32_t maxCycles = 0;
+    for (uint32_t i = 0; i < records && res.ok; i++) {
+        ArchiveRecord r = benchRecord(i);
+        uint32_t t0 = ESP.getCycleCount();
+        res.ok = archive->add(r);
+        uint32_t dt = ESP.getCycleCount() - t0;
+        total += dt;
+        if (dt > maxCycles) maxCycles = dt;
+    }
+    res.add_max_us = cyclesToUs(maxCycles);
+    res.ok = res.ok && archive->flush();
+    FlashStats fs = flash.stats();
+    if (records) {
+        res.add_us     = cyclesToUs(total) / records;
+        res.add_bytes  = (float)fs.programmed / records;
+        res.add_erases = (float)fs.erases / records;
+    }
+    res.add_amp = fs.amplification();
+
+    // 2) Отправка: очередная pending-запись и подтверждение
+    flash.resetStats();
+    uint64_t nextTotal = 0, updateTotal = 0;
+    uint32_t sent = 0;
+    for (; sent < records && res.ok; sent++) {
+        uint32_t idx;
+        ArchiveRecord r;
+        uint32_t t0 = ESP.getCycleCount();
+        res.ok = archive->getNextPending(idx, r);
+        uint32_t t1 = ESP.getCycleCount();
+        archive->updateStatus(idx, 1);
+        uint32_t t2 = ESP.getCycleCount();
+        nextTotal   += t1 - t0;
+        updateTotal += t2 - t1;
+    }
+    res.ok = res.ok && archive->flush() && archive->pendingCount() == 0;
+    fs = flash.stats();
+    if (sent) {
+        res.next_us    = cyclesToUs(nextTotal) / sent;
+        res.update_us  = cyclesToUs(updateTotal) / sent;
+        res.ack_bytes  = (float)fs.programmed / sent;
+        res.ack_erases = (float)fs.erases / sent;
+    }
+
+    // 3) Сбой питания: несброшенный хвост теряется, архив открывается заново
+    for (uint32_t i = 0; i < BENCH_TAIL_RECORDS; i++) archive->add(benchRecord(records + i));
+    delete archive;
+    archive = new (std::nothrow) ArchiveManager();
+    if (!archive) {
+        res.ok = false;
+        return res;
+    }
+    uint32_t t0 = micros();
+    res.ok = archive->begin(flash, "/archive") && res.ok;
+    res.recovery_ms = (micros() - t0) / 1000.0f;
+    res.ok = res.ok && archive->endIndex() >= records;
+    res.flash_bytes = flash.usedBytes();
+    delete archive;
+    return res;
+}
+
+void ArchiveBench::report(Print& out) {
+    static const uint32_t sizes[] = {1000, 10000, 100000};
+    out.printf("[Bench] Архив: сегмент %u записей, групповой коммит %u, блок флеша %u байт\n",
+               (unsigned)ArchiveManager::SEGMENT_RECORDS, (unsigned)BENCH_GROUP_RECORDS,
+               (unsigned)FLASH_EMU_BLOCK);
+    out.println("[Bench] records | add us avg/max | next us | update us | add B/rec erase/rec WA | "
+                "ack B/rec erase/rec | recovery ms | flash KB");
+    for (uint32_t n : sizes) {
+        ArchiveBenchResult r = run(n);
+        out.printf("[Bench] %7lu | %5.2f/%7.1f | %7.3f | %9.3f | %7.1f %9.4f %4.2f | %7.1f %9.4f | %11.2f | %8lu%s\n",
+                   (unsigned long)r.records, r.add_us, r.add_max_us, r.next_us, r.update_us,
+                   r.add_bytes, r.add_erases, r.add_amp, r.ack_bytes, r.ack_erases,
+                   r.recovery_ms, (unsigned long)(r.flash_bytes / 1024),
+                   r.ok ? "" : "  ОШИБКА");
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef ARCHIVE_BENCH_H
+#define ARCHIVE_BENCH_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Результат прогона ArchiveBench на одном объёме архива.
+ */
+struct ArchiveBenchResult {
+    uint32_t records;          ///< Записей в прогоне
+    bool     ok;               ///< Все операции прошли
+    float    add_us;           ///< add(): среднее на запись, мкс
+    float    add_max_us;       ///< add(): худший случай (сброс, закрытие сегмента), мкс
+    float    next_us;          ///< getNextPending(): среднее, мкс
+    float    update_us;        ///< updateStatus(): среднее, мкс
+    float    add_bytes;        ///< Запрограммировано байт на добавленную запись
+    float    add_erases;       ///< Стёрто блоков на добавленную запись
+    float    add_amp;          ///< Усиление записи при добавлении (programmed / written)
+    float    ack_bytes;        ///< Запрограммировано байт на смену статуса
+    float    ack_erases;       ///< Стёрто блоков на смену статуса
+    float    recovery_ms;      ///< begin() после сбоя питания (без последнего сброса), мс
+    size_t   flash_bytes;      ///< Занято на флеше в конце прогона
+};
+
+/**
+ * @brief Стенд производительности ArchiveManager на эмуляторе флеша.
+ *
+ * Архив работает поверх FlashEmulator, поэтому раздел с данными не
+ * трогается, а износ флеша считается точно по модели LittleFS. Прогон:
+ * records добавлений с групповым коммитом как в рабочем режиме, затем
+ * отправка всех записей (getNextPending() + updateStatus()), затем ещё
+ * пачка добавлений без сброса и повторное открытие — время восстановления.
+ * Операции быстрее микросекунды, поэтому время меряется в тактах ЦП.
+ *
+ * Собирается с флагом ARCHIVE_BENCH (см. env:archive-bench в platformio.ini):
+ * вместо рабочего режима setup() печатает отчёт в Serial.
+ */
+class ArchiveBench {
+public:
+    /// Один прогон на records записей (не больше ArchiveManager::MAX_RECORDS)
+    static ArchiveBenchResult run(uint32_t records);
+
+    /// Прогоны на 1k, 10k и 100k записей с таблицей результатов
+    static void report(Print& out);
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include "ArchiveCodec.h"
+#include <math.h>
+
+namespace {
+
+enum Column : uint8_t { COL_CLIENT, COL_COW, COL_TIME, COL_VOLUME, COL_EC, COL_STATUS, COL_COUNT };
+enum Mode : uint8_t { MODE_PLAIN = 0, MODE_RLE = 1 };
+
+inline uint32_t zigzag(int32_t v)   { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+inline int32_t  unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+inline uint8_t varintSize(uint32_t v) {
+    uint8_t n = 1;
+    while (v >= 0x80) { v >>= 7; n++; }
+    return n;
+}
+
+int32_t toFixed(float v) {
+    if (!isfinite(v)) return 0;
+    return (int32_t)lroundf(v * ArchiveCodec::FIXED_SCALE);
+}
+
+// Буферизованная запись в файл: varint-коды выходят по байту
+struct Writer {
+    File&   f;
+    uint8_t buf[64];
+    uint8_t len = 0;
+    bool    ok  = true;
+    explicit Writer(File& file) : f(file) {}
+    void byte(uint8_t b) {
+        buf[len++] = b;
+        if (len == sizeof(buf)) flush();
+    }
+    void varint(uint32_t v) {
+        while (v >= 0x80) { byte((uint8_t)(v | 0x80)); v >>= 7; }
+        byte((uint8_t)v);
+    }
+    void flush() {
+        if (len && f.write(buf, len) != len) ok = false;
+        len = 0;
+    }
+};
+
+// Буферизованное чтение из файла (может прочитать чуть дальше конца блока)
+struct Reader {
+    File&   f;
+    uint8_t buf[64];
+    uint8_t pos = 0, len = 0;
+    bool    ok  = true;
+    explicit Reader(File& file) : f(file) {}
+    uint8_t byte() {
+        if (pos == len) {
+            len = (uint8_t)f.read(buf, sizeof(buf));
+            pos = 0;
+            if (len == 0) { ok = false; return 0; }
+        }
+        return buf[pos++];
+    }
+    uint32_t varint() {
+        uint32_t v = 0;
+        for (uint8_t shift = 0; shift < 35 && ok; shift += 7) {
+            uint8_t b = byte();
+            v |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+};
+
+void columnCodes(const ArchiveRecord* recs, uint16_t count, uint8_t col, uint32_t* codes) {
+    uint32_t prevTs = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        const ArchiveRecord& r = recs[i];
+        switch (col) {
+            case COL_CLIENT: codes[i] = r.client_id; break;
+            case COL_COW:    codes[i] = r.cow_id;    break;
+            case COL_TIME:
+                codes[i] = zigzag((int32_t)(r.timestamp - prevTs));
+                prevTs   = r.timestamp;
+                break;
+            case COL_VOLUME: codes[i] = zigzag(toFixed(r.volume)); break;
+            case COL_EC:     codes[i] = zigzag(toFixed(r.ec));     break;
+            default:         codes[i] = r.status;                  break;
+        }
+    }
+}
+
+void applyCode(ArchiveRecord& r, uint8_t col, uint32_t code, uint32_t& prevTs) {
+    switch (col) {
+        case COL_CLIENT: r.client_id = code; break;
+        case COL_COW:    r.cow_id    = code; break;
+        case COL_TIME:
+            prevTs     += (uint32_t)unzigzag(code);
+            r.timestamp = prevTs;
+            break;
+        case COL_VOLUME: r.volume = (float)unzigzag(code) / ArchiveCodec::FIXED_SCALE; break;
+        case COL_EC:     r.ec     = (float)unzigzag(code) / ArchiveCodec::FIXED_SCALE; break;
+        default:         r.status = (uint8_t)code; break;
+    }
+}
+
+} // namespace
+
+bool ArchiveCodec::encodeBlock(File& out, const ArchiveRecord* recs, uint16_t count) {
+    if (count > ARCHIVE_CODEC_MAX_BLOCK) return false;
+    uint32_t codes[ARCHIVE_CODEC_MAX_BLOCK];
+    Writer w(out);
+
+    for (uint8_t col = 0; col < COL_COUNT; col++) {
+        columnCodes(recs, count, col, codes);
+
+        // Размер в обоих режимах, выбираем меньший
+        size_t plain = 0, rle = 0;
+        for (uint16_t i = 0; i < count; ) {
+            uint16_t run = 1;
+            while (i + run < count && codes[i + run] == codes[i]) run++;
+            plain += (size_t)varintSize(codes[i]) * run;
+            rle   += varintSize(run) + varintSize(codes[i]);
+            i += run;
+        }
+
+        if (rle < plain) {
+            w.byte(MODE_RLE);
+            for (uint16_t i = 0; i < count; ) {
+                uint16_t run = 1;
+                while (i + run < count && codes[i + run] == codes[i]) run++;
+                w.varint(run);
+                w.varint(codes[i]);
+                i += run;
+            }
+        } else {
+            w.byte(MODE_PLAIN);
+            for (uint16_t i = 0; i < count; i++) w.varint(codes[i]);
+        }
+    }
+    w.flush();
+    return w.ok;
+}
+
+bool ArchiveCodec::decodeBlock(File& in, ArchiveRecord* recs, uint16_t count) {
+    Reader rd(in);
+    for (uint16_t i = 0; i < count; i++) memset(&recs[i], 0, sizeof(ArchiveRecord));
+
+    for (uint8_t col = 0; col < COL_COUNT && rd.ok; col++) {
+        uint8_t  mode   = rd.byte();
+        uint32_t prevTs = 0;
+        if (mode == MODE_RLE) {
+            for (uint16_t i = 0; i < count && rd.ok; ) {
+                uint32_t run  = rd.varint();
+                uint32_t code = rd.varint();
+                if (run == 0 || run > (uint32_t)(count - i)) return false;
+                for (; run > 0; run--, i++) applyCode(recs[i], col, code, prevTs);
+            }
+        } else if (mode == MODE_PLAIN) {
+            for (uint16_t i = 0; i < count && rd.ok; i++) applyCode(recs[i], col, rd.varint(), prevTs);
+        } else {
+            return false;
+        }
+    }
+    return rd.ok;
+}
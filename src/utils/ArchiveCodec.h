@@ -0,0 +1,44 @@
+#ifndef ARCHIVE_CODEC_H
+#define ARCHIVE_CODEC_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "ArchiveManager.h"
+
+// Наибольший блок, который кодек сжимает за раз (в записях)
+#ifndef ARCHIVE_CODEC_MAX_BLOCK
+#define ARCHIVE_CODEC_MAX_BLOCK 64
+#endif
+
+/**
+ * @brief Колоночное сжатие блока записей архива.
+ *
+ * Блок хранится по столбцам: client_id, cow_id, timestamp, volume, ec,
+ * status. Каждое значение столбца переводится в беззнаковый код:
+ *  - client_id, cow_id, status — как есть;
+ *  - timestamp — zigzag-разность с предыдущей записью блока;
+ *  - volume, ec — zigzag фиксированной точки (значение * FIXED_SCALE).
+ * Столбец начинается с байта режима: 0 — коды подряд в varint,
+ * 1 — RLE-пары (длина серии, код) в varint. Кодировщик выбирает более
+ * короткий режим для каждого столбца отдельно.
+ *
+ * volume и ec сохраняются с точностью 1/FIXED_SCALE.
+ */
+class ArchiveCodec {
+public:
+    static const int32_t FIXED_SCALE = 100;
+
+    /**
+     * @brief Сжать count записей и дописать их в out с текущей позиции.
+     * @return false при ошибке записи или count > ARCHIVE_CODEC_MAX_BLOCK
+     */
+    static bool encodeBlock(File& out, const ArchiveRecord* recs, uint16_t count);
+
+    /**
+     * @brief Распаковать блок из count записей с текущей позиции in.
+     * @return false, если данные обрываются или повреждены
+     */
+    static bool decodeBlock(File& in, ArchiveRecord* recs, uint16_t count);
+};
+
+#endif
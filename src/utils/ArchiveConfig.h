@@ -0,0 +1,69 @@
+#ifndef ARCHIVE_CONFIG_H
+#define ARCHIVE_CONFIG_H
+
+// Параметры архива (ArchiveManager, журнал статусов, курсоры потребителей).
+// Любой можно переопределить в build_flags
+
+// Размер сегмента архива (в записях) и максимальное число сегментов на флеше.
+// 1024 * 128 = 131072 записей; подбирайте под размер раздела LittleFS.
+#ifndef ARCHIVE_SEGMENT_RECORDS
+#define ARCHIVE_SEGMENT_RECORDS 1024
+#endif
+#ifndef ARCHIVE_MAX_SEGMENTS
+#define ARCHIVE_MAX_SEGMENTS    128
+#endif
+// Ёмкость буферов группового коммита (новые записи и смены статусов)
+#ifndef ARCHIVE_GROUP_COMMIT_MAX
+#define ARCHIVE_GROUP_COMMIT_MAX 64
+#endif
+// Сколько карт статусов сегментов держать в RAM (по SEGMENT_RECORDS/4 байт)
+#ifndef ARCHIVE_STATUS_MAPS
+#define ARCHIVE_STATUS_MAPS 4
+#endif
+// Записей в блоке индекса времени (min/max timestamp на блок); он же блок сжатия
+#ifndef ARCHIVE_TIME_BLOCK
+#define ARCHIVE_TIME_BLOCK 64
+#endif
+// 1 — закрытые сегменты сжимаются в колоночный формат (.csg), 0 — остаются как есть
+#ifndef ARCHIVE_PACK_SEALED
+#define ARCHIVE_PACK_SEALED 1
+#endif
+
+// Кэш хвоста архива в PSRAM (в записях, 24 байта каждая); 0 — без кэша
+#ifndef ARCHIVE_TAIL_CACHE
+#ifdef BOARD_HAS_PSRAM
+#define ARCHIVE_TAIL_CACHE 10240
+#else
+#define ARCHIVE_TAIL_CACHE 0
+#endif
+#endif
+// Сколько именованных потребителей (курсоров доставки) поддерживает архив
+#ifndef ARCHIVE_MAX_CONSUMERS
+#define ARCHIVE_MAX_CONSUMERS 4
+#endif
+// Очередь приёма перед архивом (в записях, степень двойки)
+#ifndef ARCHIVE_INGEST_QUEUE
+#define ARCHIVE_INGEST_QUEUE 64
+#endif
+// Слотов несжатого сегмента за одно чтение при последовательном обходе
+#ifndef ARCHIVE_SCAN_CHUNK
+#define ARCHIVE_SCAN_CHUNK 8
+#endif
+// Уплотнение: начинается, когда сегментов на флеше больше этого числа
+#ifndef ARCHIVE_COMPACT_WATERMARK
+#define ARCHIVE_COMPACT_WATERMARK (ARCHIVE_MAX_SEGMENTS * 3 / 4)
+#endif
+// Сегмент уплотняется, только если в нём не больше стольких pending-записей
+#ifndef ARCHIVE_COMPACT_MAX_LIVE
+#define ARCHIVE_COMPACT_MAX_LIVE (ARCHIVE_SEGMENT_RECORDS / 8)
+#endif
+// Сколько pending-записей переносить за один шаг уплотнения
+#ifndef ARCHIVE_COMPACT_BATCH
+#define ARCHIVE_COMPACT_BATCH 16
+#endif
+// Сколько перенесённых уплотнением копий помнят номер оригинала (по 8 байт)
+#ifndef ARCHIVE_RELOC_MAX
+#define ARCHIVE_RELOC_MAX 128
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+#include "ArchiveConsumers.h"
+
+void ArchiveConsumers::load(fs::FS& fs, const String& dir, uint32_t end) {
+    _fs    = &fs;
+    _dir   = dir;
+    _count = 0;
+    _dirty = false;
+    File f = _fs->open(_dir + "/cursors", "r");
+    if (!f) return;
+    CursorFile cf;
+    if (f.read((uint8_t*)&cf, sizeof(cf)) == sizeof(cf) && cf.magic == MAGIC && cf.count <= CAPACITY) {
+        _count = (uint8_t)cf.count;
+        memcpy(_items, cf.consumers, sizeof(_items));
+        for (uint8_t i = 0; i < _count; i++) {
+            _items[i].name[NAME_LEN] = 0;
+            if (_items[i].cursor > end) _items[i].cursor = end;
+        }
+    }
+    f.close();
+}
+
+bool ArchiveConsumers::save() {
+    File f = _fs->open(_dir + "/cursors", "w");
+    if (!f) return false;
+    CursorFile cf;
+    memset(&cf, 0, sizeof(cf));
+    cf.magic = MAGIC;
+    cf.count = _count;
+    memcpy(cf.consumers, _items, sizeof(Consumer) * _count);
+    bool ok = f.write((const uint8_t*)&cf, sizeof(cf)) == sizeof(cf);
+    f.close();
+    if (ok) _dirty = false;
+    return ok;
+}
+
+int8_t ArchiveConsumers::find(const char* name) const {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (strncmp(_items[i].name, name, NAME_LEN) == 0) return (int8_t)i;
+    }
+    return -1;
+}
+
+int8_t ArchiveConsumers::open(const char* name, uint32_t cursor) {
+    if (!name || !*name || _count >= CAPACITY) return -1;
+    // Имя попадает в JSON и файл курсоров — только латиница, цифры, '_' и '-'
+    for (const char* p = name; *p; p++) {
+        if (!isalnum((unsigned char)*p) && *p != '_' && *p != '-') return -1;
+    }
+    Consumer& c = _items[_count];
+    memset(&c, 0, sizeof(c));
+    strncpy(c.name, name, NAME_LEN);
+    c.cursor = cursor;
+    _dirty = true;
+    return (int8_t)_count++;
+}
+
+bool ArchiveConsumers::close(const char* name) {
+    int8_t id = find(name);
+    if (id < 0) return false;
+    memmove(&_items[id], &_items[id + 1], sizeof(Consumer) * (_count - id - 1));
+    _count--;
+    _dirty = true;
+    return true;
+}
+
+void ArchiveConsumers::ack(uint8_t id, uint32_t end) {
+    if (id >= _count || end <= _items[id].cursor) return;
+    _items[id].cursor = end;
+    _dirty = true;
+}
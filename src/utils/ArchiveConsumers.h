@@ -0,0 +1,61 @@
+#ifndef ARCHIVE_CONSUMERS_H
+#define ARCHIVE_CONSUMERS_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "ArchiveConfig.h"
+
+/**
+ * @brief Именованные курсоры доставки архива (файл <dir>/cursors).
+ *
+ * Курсор — номер первой недоставленной потребителю записи. Все курсоры
+ * пишутся одним файлом: save() вызывается при сбросе группового коммита
+ * архива, если dirty(). Мьютекса нет — вызывает ArchiveManager под своим.
+ */
+class ArchiveConsumers {
+public:
+    static const uint8_t CAPACITY = ARCHIVE_MAX_CONSUMERS;
+    static const uint8_t NAME_LEN = 15;
+
+    /// Прочитать курсоры; курсоры дальше end (хвост отброшен после сбоя) — на end
+    void load(fs::FS& fs, const String& dir, uint32_t end);
+    bool save();
+
+    /// Номер потребителя по имени или -1
+    int8_t find(const char* name) const;
+    /**
+     * @brief Завести потребителя с курсором cursor.
+     * @return номер или -1, если имя недопустимо или все CAPACITY заняты
+     */
+    int8_t open(const char* name, uint32_t cursor);
+    /// Удалить потребителя; номера следующих сдвигаются
+    bool   close(const char* name);
+    /// Сдвинуть курсор вперёд до end (назад не двигается)
+    void   ack(uint8_t id, uint32_t end);
+
+    uint8_t     count() const { return _count; }
+    uint32_t    cursor(uint8_t id) const { return _items[id].cursor; }
+    const char* name(uint8_t id) const { return id < _count ? _items[id].name : ""; }
+    bool        dirty() const { return _dirty; }
+
+private:
+    /// Курсор потребителя (запись файла)
+    struct Consumer {
+        char     name[NAME_LEN + 1];
+        uint32_t cursor;
+    };
+    struct CursorFile {
+        uint32_t magic;
+        uint32_t count;
+        Consumer consumers[CAPACITY];
+    };
+    static const uint32_t MAGIC = 0x52434D41; // "AMCR"
+
+    fs::FS*  _fs = nullptr;
+    String   _dir;
+    Consumer _items[CAPACITY];
+    uint8_t  _count = 0;
+    bool     _dirty = false;
+};
+
+#endif
@@ -1,76 +1,1612 @@
 #include "ArchiveManager.h"
+#include "ArchiveCodec.h"
+#include "Crc.h"
+#include <algorithm>
+#include <new>
+#include <esp_heap_caps.h>
 
-void ArchiveManager::begin() {
-    EEPROM.begin(EEPROM_SIZE);
-    write_index = 0; // можно загрузить из EEPROM, если нужно сохранять между перезагрузками
+static_assert(ARCHIVE_TIME_BLOCK <= ARCHIVE_CODEC_MAX_BLOCK, "блок сжатия больше, чем умеет ArchiveCodec");
+
+ArchiveManager::ArchiveManager() {
+    _mutex = xSemaphoreCreateRecursiveMutex();
+}
+
+ArchiveManager::~ArchiveManager() {
+    if (_tail) heap_caps_free(_tail);
+    if (_mutex) vSemaphoreDelete(_mutex);
+}
+
+bool ArchiveManager::begin(fs::FS& fs, const char* dir) {
+    Lock lock(_mutex);
+    _fs  = &fs;
+    _dir = dir;
+    if (!_fs->exists(_dir) && !_fs->mkdir(_dir)) {
+        Serial.printf("[Archive] Не удалось создать каталог %s\n", dir);
+        return false;
+    }
+
+    // Ищем диапазон номеров сегментов: имена файлов — hex-номер + ".seg"
+    bool found = false;
+    uint32_t minSeg = 0, maxSeg = 0;
+    File root = _fs->open(_dir);
+    for (File f = root.openNextFile(); f; f = root.openNextFile()) {
+        String name = f.name();
+        f.close();
+        int slash = name.indexOf('/');
+        while (slash >= 0) {                 // name() может вернуть полный путь
+            name = name.substring(slash + 1);
+            slash = name.indexOf('/');
+        }
+        if (!name.endsWith(".seg") && !name.endsWith(".csg")) continue;
+        uint32_t seg = strtoul(name.c_str(), nullptr, 16);
+        if (!found || seg < minSeg) minSeg = seg;
+        if (!found || seg > maxSeg) maxSeg = seg;
+        found = true;
+    }
+    root.close();
+
+    _firstSeg = minSeg;
+    _headSeg  = maxSeg;
+    _readSeg  = UINT32_MAX;
+    _blockSeg = UINT32_MAX;
+    _statusLog.begin(fs, _dir);
+    if (!_openHead(_headSeg, !found)) return false;
+
+    // Сжатие предыдущего сегмента могло прерваться: доводим его до конца
+    if (_headSeg > _firstSeg) {
+        uint32_t prev = _headSeg - 1;
+        _fs->remove(_segmentPath(prev, ".tmp"));
+        if (_fs->exists(_segmentPath(prev, ".csg"))) {
+            _fs->remove(_segmentPath(prev));
+        } else if (ARCHIVE_PACK_SEALED) {
+            _packSegment(prev);
+        }
+    }
+    _loadIndexes();
+
+    // Курсор и счётчики: берём сохранённые и досматриваем только хвост,
+    // дописанный/подтверждённый после последнего сохранения
+    _loadState();
+    // Нумерация начинается заново — новый идентификатор, чтобы получатели
+    // не сочли записи нового архива уже полученными
+    if (!found || !_archiveId) _archiveId = esp_random() | 1;
+    _advancePendingHead();
+    _saveState();
+    _consumers.load(fs, _dir, _endIndex());
+    _loadRelocations();
+    _loadRollups();
+    _loadTail();
+
+    Serial.printf("[Archive] Сегменты %lu..%lu, записей: %lu, pending: %lu с %lu\n",
+                  (unsigned long)_firstSeg, (unsigned long)_headSeg,
+                  (unsigned long)_counters.total, (unsigned long)_counters.pending,
+                  (unsigned long)_pendingHead);
+    return true;
+}
+
+void ArchiveManager::_loadState() {
+    _pendingHead = _firstIndex();
+    _counters    = {0, 0, 0, 0};
+    _archiveId   = 0;
+    uint32_t countedEnd = _firstIndex();
+
+    File f = _fs->open(_dir + "/state", "r");
+    if (f) {
+        StateFile st;
+        if (f.read((uint8_t*)&st, sizeof(st)) == sizeof(st) && st.magic == STATE_MAGIC
+            && st.counted_end >= _firstIndex() && st.counted_end <= _endIndex()) {
+            _pendingHead = st.pending_head;
+            _counters    = st.counters;
+            countedEnd   = st.counted_end;
+            _archiveId   = st.archive_id;
+        }
+        f.close();
+    }
+    if (_pendingHead < _firstIndex()) _pendingHead = _firstIndex();
+    if (_pendingHead > _endIndex())   _pendingHead = _endIndex();
+
+    // Записи, добавленные после последнего сохранения (или весь архив,
+    // если состояния нет), досчитываем одним последовательным проходом
+    _scan(countedEnd, [&](uint32_t, const ArchiveRecord& r) {
+        _countStatus(r.status, +1);
+        return true;
+    });
 }
 
-void ArchiveManager::add(const ArchiveRecord& record) {
-    writeRecord(write_index, record);
-    write_index = (write_index + 1) % MAX_RECORDS;
-    EEPROM.commit();
+void ArchiveManager::_loadRollups() {
+    if (!_rollup.begin(*_fs, _dir + "/rollup")) return;
+    uint32_t from = _rollup.rolledEnd();
+    if (from > _endIndex()) {           // итоги от другого архива
+        _rollup.clear();
+        from = 0;
+    }
+    if (from >= _endIndex()) return;
+    if (from < _firstIndex()) from = _firstIndex();
+
+    // Досчитываем хвост архива, не попавший в итоги (или весь архив впервые)
+    uint32_t t0 = millis();
+    _scan(from, [&](uint32_t idx, const ArchiveRecord& r) {
+        if (_origin(idx) != idx) return true;   // копия уплотнения: оригинал уже учтён
+        if (!_rollup.add(r)) {
+            _rollup.flush(idx);
+            _rollup.add(r);
+        }
+        return true;
+    });
+    _rollup.flush(_endIndex());
+    Serial.printf("[Archive] Итоги досчитаны с %lu за %lu мс\n",
+                  (unsigned long)from, (unsigned long)(millis() - t0));
 }
 
-void ArchiveManager::writeRecord(uint16_t index, const ArchiveRecord& record) {
-    int addr = index * RECORD_SIZE;
-    EEPROM.put(addr, record);
+void ArchiveManager::_loadTail() {
+    _cacheStats = {0, 0, 0};          // пока кэш заполняется, чтения идут с флеша
+#if ARCHIVE_TAIL_CACHE
+    if (!_tail) {
+        _tail = (ArchiveRecord*)heap_caps_malloc((size_t)ARCHIVE_TAIL_CACHE * sizeof(ArchiveRecord),
+                                                 MALLOC_CAP_SPIRAM);
+        if (!_tail) {
+            Serial.println("[Archive] Нет памяти PSRAM под кэш хвоста, работаем без него");
+            return;
+        }
+    }
+    uint32_t end   = _endIndex();
+    uint32_t start = end - _firstIndex() > ARCHIVE_TAIL_CACHE ? end - ARCHIVE_TAIL_CACHE : _firstIndex();
+    uint32_t t0    = millis();
+    // Кэш держит только непрерывный хвост: после пропуска (повреждённая
+    // запись, пропавший сегмент) начинаем его заново
+    uint32_t next = start;
+    _scan(start, [&](uint32_t idx, const ArchiveRecord& r) {
+        if (idx != next) start = idx;
+        _tail[idx % ARCHIVE_TAIL_CACHE] = r;
+        next = idx + 1;
+        return true;
+    });
+    _tailStart  = next == end ? start : end;
+    _cacheStats = {ARCHIVE_TAIL_CACHE, 0, 0};
+    Serial.printf("[Archive] Кэш хвоста: %lu записей за %lu мс\n",
+                  (unsigned long)(end - _tailStart), (unsigned long)(millis() - t0));
+#endif
 }
 
-bool ArchiveManager::readRecord(uint16_t index, ArchiveRecord& record) {
-    if (index >= MAX_RECORDS) return false;
-    int addr = index * RECORD_SIZE;
-    EEPROM.get(addr, record);
+void ArchiveManager::_saveState() {
+    File f = _fs->open(_dir + "/state", "w");
+    if (!f) return;
+    // Сохраняем только то, что уже лежит на флеше: записи из буфера
+    // после перезагрузки будут досчитаны (или потеряны вместе с буфером)
+    StateFile st{STATE_MAGIC, _pendingHead, _flushedEnd(), _counters, _archiveId};
+    for (uint16_t i = 0; i < _batchCount; i++) {
+        st.counters.total--;
+        switch (_batch[i].status) {
+            case 0:  st.counters.pending--; break;
+            case 1:  st.counters.sent--;    break;
+            default: st.counters.error--;   break;
+        }
+    }
+    if (st.pending_head > st.counted_end) st.pending_head = st.counted_end;
+    f.write((const uint8_t*)&st, sizeof(st));
+    f.close();
+    _stateDirty = false;
+}
+
+void ArchiveManager::_countStatus(uint8_t status, int32_t delta) {
+    if (status == STATUS_MOVED) return;    // запись представляет копия
+    _counters.total += delta;
+    switch (status) {
+        case 0:  _counters.pending += delta; break;
+        case 1:  _counters.sent    += delta; break;
+        default: _counters.error   += delta; break;
+    }
+}
+
+void ArchiveManager::_advancePendingHead() {
+    if (_pendingHead < _firstIndex()) _pendingHead = _firstIndex();
+    uint32_t head = _endIndex();   // pending-записей нет — курсор в конце архива
+    _scan(_pendingHead, [&](uint32_t idx, const ArchiveRecord& r) {
+        if (r.status != 0) return true;
+        head = idx;
+        return false;
+    });
+    _pendingHead = head;
+}
+
+String ArchiveManager::_segmentPath(uint32_t seg, const char* ext) const {
+    char name[16];
+    snprintf(name, sizeof(name), "/%08lX%s", (unsigned long)seg, ext);
+    return _dir + name;
+}
+
+bool ArchiveManager::_storedStatus(uint32_t index, uint8_t& status) {
+    for (uint16_t i = 0; i < _ackCount; i++) {
+        if (_acks[i].index == index) {
+            status = _acks[i].status;
+            return true;
+        }
+    }
+    uint8_t st = _statusLog.map(index / SEGMENT_RECORDS)->get(index % SEGMENT_RECORDS);
+    if (st != ArchiveStatusLog::NONE) {
+        status = st;
+        return true;
+    }
+    // В журнале нет — начальный статус из тела записи
+    ArchiveRecord r;
+    if (!_readSlot(index / SEGMENT_RECORDS, index % SEGMENT_RECORDS, r)) return false;
+    status = r.status;
     return true;
 }
 
-bool ArchiveManager::getNextPending(uint16_t &outIndex, ArchiveRecord &outRec) {
-    // Перебираем все возможные индексы
-    for (uint16_t i = 0; i < MAX_RECORDS; i++) {
-        ArchiveRecord r;
-        if (readRecord(i, r) && r.status == 0) {  // 0 = pending
-            outIndex = i;
-            outRec   = r;
+void ArchiveManager::_resetHeadTime() {
+    for (uint16_t b = 0; b < TIME_BLOCKS; b++) _headTime[b] = {UINT32_MAX, 0};
+    _segTime[_headSeg % MAX_SEGMENTS] = {UINT32_MAX, 0};
+}
+
+void ArchiveManager::_loadIndexes() {
+    for (uint16_t i = 0; i < MAX_SEGMENTS; i++) _segTime[i] = {UINT32_MAX, 0};
+
+    // Закрытые сегменты: берём из файла, недостающие (старый архив или сбой
+    // до записи индекса) достраиваем одним проходом по сегменту
+    for (uint32_t seg = _firstSeg; seg < _headSeg; seg++) {
+        TimeIndexEntry e;
+        if (!_readTimeEntry(seg, e)) {
+            e.seg   = seg;
+            e.range = {UINT32_MAX, 0};
+            for (uint16_t b = 0; b < TIME_BLOCKS; b++) e.blocks[b] = {UINT32_MAX, 0};
+            uint32_t end = (seg + 1) * SEGMENT_RECORDS;
+            _scan(seg * SEGMENT_RECORDS, [&](uint32_t idx, const ArchiveRecord& r) {
+                if (idx >= end) return false;
+                e.blocks[(idx % SEGMENT_RECORDS) / TIME_BLOCK].extend(r.timestamp);
+                e.range.extend(r.timestamp);
+                return true;
+            });
+            _saveTimeEntry(e);
+        }
+        _segTime[seg % MAX_SEGMENTS] = e.range;
+    }
+
+    // Головной сегмент индексируется в RAM по мере add(); у битых слотов,
+    // которые _scan() пропускает, коровы нет
+    _resetHeadTime();
+    for (uint32_t i = 0; i < SEGMENT_RECORDS; i++) _headCows[i] = NO_COW;
+    _scan(_headSeg * SEGMENT_RECORDS, [&](uint32_t idx, const ArchiveRecord& r) {
+        _headCows[idx % SEGMENT_RECORDS] = r.cow_id;
+        _headTime[(idx % SEGMENT_RECORDS) / TIME_BLOCK].extend(r.timestamp);
+        _segTime[_headSeg % MAX_SEGMENTS].extend(r.timestamp);
+        return true;
+    });
+}
+
+bool ArchiveManager::_readTimeEntry(uint32_t seg, TimeIndexEntry& entry) {
+    File f = _fs->open(_dir + "/tindex", "r");
+    if (!f) return false;
+    bool ok = f.seek((seg % MAX_SEGMENTS) * sizeof(TimeIndexEntry), SeekSet)
+              && f.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry)
+              && entry.seg == seg;
+    f.close();
+    return ok;
+}
+
+bool ArchiveManager::_saveTimeEntry(const TimeIndexEntry& entry) {
+    String path = _dir + "/tindex";
+    File f = _fs->open(path, _fs->exists(path) ? "r+" : "w+");
+    if (!f) return false;
+    size_t off = (entry.seg % MAX_SEGMENTS) * sizeof(TimeIndexEntry);
+    // Файл растёт до нужного слота явно, не полагаясь на seek за конец
+    if (f.size() < off) {
+        TimeIndexEntry empty;
+        memset(&empty, 0xFF, sizeof(empty));
+        f.seek(f.size() - f.size() % sizeof(TimeIndexEntry), SeekSet);
+        while (f.position() < off) f.write((const uint8_t*)&empty, sizeof(empty));
+    }
+    f.seek(off, SeekSet);
+    bool ok = f.write((const uint8_t*)&entry, sizeof(entry)) == sizeof(entry);
+    f.close();
+    return ok;
+}
+
+bool ArchiveManager::_openHead(uint32_t seg, bool create) {
+    if (_headFile) _headFile.close();
+    String path = _segmentPath(seg);
+    _headCount = 0;
+
+    if (!create && _fs->exists(path)) {
+        _headFile = _fs->open(path, "r+");
+        SegmentHeader hdr;
+        bool hdrOk = _headFile && _headFile.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr)
+                     && hdr.magic == SEGMENT_MAGIC;
+        if (hdrOk && hdr.version == 1 && hdr.record_size == RECORD_SIZE) {
+            _headFile.close();
+            hdrOk = _upgradeSegment(seg) && (_headFile = _fs->open(path, "r+"))
+                    && _headFile.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr);
+        }
+        if (hdrOk && hdr.record_size == SLOT_SIZE) {
+            // Неполный слот в хвосте (обрыв питания при записи) отбрасываем:
+            // следующая запись перезапишет его целиком
+            size_t n = (_headFile.size() - sizeof(hdr)) / SLOT_SIZE;
+            _headSeg   = seg;
+            _headCount = _recoverHead(n > SEGMENT_RECORDS ? SEGMENT_RECORDS : (uint16_t)n);
             return true;
         }
+        Serial.printf("[Archive] Повреждённый заголовок %s, сегмент пересоздаётся\n", path.c_str());
+        if (_headFile) _headFile.close();
+    }
+
+    _headFile = _fs->open(path, "w+");
+    if (!_headFile) {
+        Serial.printf("[Archive] Не удалось создать %s\n", path.c_str());
+        return false;
     }
+    SegmentHeader hdr{SEGMENT_MAGIC, FORMAT_VERSION, SLOT_SIZE, seg};
+    _headFile.write((const uint8_t*)&hdr, sizeof(hdr));
+    _headFile.flush();
+    _headSeg = seg;
+    return true;
+}
+
+uint32_t ArchiveManager::_slotCrc(const RecordSlot& s) {
+    return Crc::crc32((const uint8_t*)&s, offsetof(RecordSlot, crc));
+}
+
+bool ArchiveManager::_slotValid(const RecordSlot& s, uint32_t index) {
+    return s.seq == index && s.crc == _slotCrc(s);
+}
+
+uint16_t ArchiveManager::_recoverHead(uint16_t n) {
+    uint32_t base = _headSeg * SEGMENT_RECORDS;
+    auto valid = [&](uint16_t slot) {
+        RecordSlot s;
+        return _headFile.seek(_slotOffset(slot), SeekSet)
+               && _headFile.read((uint8_t*)&s, SLOT_SIZE) == SLOT_SIZE
+               && _slotValid(s, base + slot);
+    };
+    // Обычный случай — последний слот целый: одно чтение
+    if (n == 0 || valid(n - 1)) return n;
+
+    // Слоты пишутся только подряд, поэтому целые образуют префикс:
+    // ищем его конец двоичным поиском, [0, lo) целые, [hi, n) — нет
+    uint16_t lo = 0, hi = n - 1;
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+        if (valid(mid)) lo = mid + 1;
+        else hi = mid;
+    }
+    Serial.printf("[Archive] Сегмент %lu: отброшено %u нецелых записей в хвосте\n",
+                  (unsigned long)_headSeg, (unsigned)(n - lo));
+
+    // Хвост затираем: иначе после частичной дозаписи за головой остались бы
+    // старые слоты, которые при следующем восстановлении сошли бы за целые
+    RecordSlot zero;
+    memset(&zero, 0, sizeof(zero));
+    _headFile.seek(_slotOffset(lo), SeekSet);
+    for (uint16_t i = lo; i < n; i++) _headFile.write((const uint8_t*)&zero, SLOT_SIZE);
+    _headFile.flush();
+    return lo;
+}
+
+bool ArchiveManager::_upgradeSegment(uint32_t seg) {
+    String path = _segmentPath(seg);
+    String tmp  = _segmentPath(seg, ".tmp");
+    File in = _fs->open(path, "r");
+    if (!in) return false;
+    File out = _fs->open(tmp, "w");
+    SegmentHeader hdr{SEGMENT_MAGIC, FORMAT_VERSION, SLOT_SIZE, seg};
+    bool ok = out && in.seek(sizeof(SegmentHeader), SeekSet)
+              && out.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr);
+    RecordSlot s;
+    memset(&s, 0, sizeof(s));
+    uint16_t n = 0;
+    while (ok && n < SEGMENT_RECORDS && in.read((uint8_t*)&s.record, RECORD_SIZE) == RECORD_SIZE) {
+        s.seq = seg * SEGMENT_RECORDS + n++;
+        s.crc = _slotCrc(s);
+        ok = out.write((const uint8_t*)&s, SLOT_SIZE) == SLOT_SIZE;
+    }
+    in.close();
+    if (out) out.close();
+    if (!ok || !_fs->rename(tmp, path)) {
+        _fs->remove(tmp);
+        Serial.printf("[Archive] Не удалось обновить формат сегмента %lu\n", (unsigned long)seg);
+        return false;
+    }
+    Serial.printf("[Archive] Сегмент %lu переведён в формат %u (%u записей)\n",
+                  (unsigned long)seg, FORMAT_VERSION, n);
+    return true;
+}
+
+bool ArchiveManager::_sealHead() {
+    // Головной сегмент заполнен — при необходимости освобождаем самый старый
+    if (_headSeg - _firstSeg + 1 >= _segmentLimit()) {
+        if (!_dropOldestSegment(_retention.dropPending)) {
+            _full = true;               // отказ считает _add(), по разу на запись
+            return false;
+        }
+        _retentionStats.evicted++;
+    }
+    // Индекс времени закрываемого сегмента больше не меняется — на флеш
+    TimeIndexEntry e;
+    e.seg   = _headSeg;
+    e.range = _segTime[_headSeg % MAX_SEGMENTS];
+    memcpy(e.blocks, _headTime, sizeof(e.blocks));
+    if (!_saveTimeEntry(e)) Serial.println("[Archive] Не удалось записать индекс времени");
+    // Без .cix история коровы по сегменту построит его при первом запросе
+    _sealCowIndex();
+
+    if (!_openHead(_headSeg + 1, true)) return false;
+    _resetHeadTime();
+#if ARCHIVE_PACK_SEALED
+    _packSegment(_headSeg - 1);   // при ошибке сегмент остаётся несжатым
+#endif
+    return true;
+}
+
+bool ArchiveManager::_packSegment(uint32_t seg) {
+    File* src = _segmentFile(seg);
+    if (!src || _readPacked) return false;
+    uint32_t t0 = micros();
+
+    PackedHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic   = PACKED_MAGIC;
+    hdr.version = FORMAT_VERSION;
+    hdr.segment = seg;
+    hdr.count   = (uint16_t)((src->size() - sizeof(SegmentHeader)) / SLOT_SIZE);
+    if (hdr.count > SEGMENT_RECORDS) hdr.count = SEGMENT_RECORDS;
+
+    // Пишем во временный файл и переименовываем: сжатый сегмент либо
+    // целый, либо его нет и остаётся исходный .seg
+    String tmp = _segmentPath(seg, ".tmp");
+    File out = _fs->open(tmp, "w");
+    if (!out) return false;
+    bool ok = out.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr);
+    _blockSeg = UINT32_MAX;                  // кэш блоков нужен как буфер
+    uint16_t damaged = 0;
+    src->seek(_slotOffset(0), SeekSet);
+    for (uint16_t b = 0; ok && b * TIME_BLOCK < hdr.count; b++) {
+        uint16_t n = hdr.count - b * TIME_BLOCK;
+        if (n > TIME_BLOCK) n = TIME_BLOCK;
+        for (uint16_t i = 0; ok && i < n; i++) {
+            RecordSlot s;
+            ok = src->read((uint8_t*)&s, SLOT_SIZE) == SLOT_SIZE;
+            if (ok && !_slotValid(s, seg * SEGMENT_RECORDS + b * TIME_BLOCK + i)) {
+                memset(&s.record, 0, sizeof(s.record));   // повреждённая запись — пустая
+                damaged++;
+            }
+            _blockCache[i] = s.record;
+        }
+        hdr.offsets[b] = out.position();
+        ok = ok && ArchiveCodec::encodeBlock(out, _blockCache, n);
+    }
+    size_t packedSize = out.size();
+    ok = ok && out.seek(0, SeekSet)
+            && out.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr);
+    out.close();
+
+    if (_readSeg == seg) {
+        _readFile.close();
+        _readSeg = UINT32_MAX;
+    }
+    if (!ok || !_fs->rename(tmp, _segmentPath(seg, ".csg"))) {
+        _fs->remove(tmp);
+        Serial.printf("[Archive] Не удалось сжать сегмент %lu\n", (unsigned long)seg);
+        return false;
+    }
+    _fs->remove(_segmentPath(seg));
+    if (damaged) {
+        Serial.printf("[Archive] Сегмент %lu: %u повреждённых записей\n", (unsigned long)seg, damaged);
+    }
+    Serial.printf("[Archive] Сегмент %lu сжат: %u -> %u байт за %lu мкс\n", (unsigned long)seg,
+                  (unsigned)(sizeof(SegmentHeader) + (size_t)hdr.count * SLOT_SIZE),
+                  (unsigned)packedSize, (unsigned long)(micros() - t0));
+    return true;
+}
+
+bool ArchiveManager::_loadBlock(uint32_t seg, uint16_t block) {
+    if (_blockSeg == seg && _blockNo == block) return true;
+    File* f = _segmentFile(seg);
+    if (!f || !_readPacked || block * TIME_BLOCK >= _packHdr.count) return false;
+    uint16_t n = _packHdr.count - block * TIME_BLOCK;
+    if (n > TIME_BLOCK) n = TIME_BLOCK;
+    _blockSeg = UINT32_MAX;
+    if (!f->seek(_packHdr.offsets[block], SeekSet)
+        || !ArchiveCodec::decodeBlock(*f, _blockCache, n)) {
+        Serial.printf("[Archive] Повреждён блок %u сегмента %lu\n", block, (unsigned long)seg);
+        return false;
+    }
+    _blockSeg = seg;
+    _blockNo  = block;
+    _blockLen = n;
+    return true;
+}
+
+bool ArchiveManager::_readSlot(uint32_t seg, uint16_t slot, ArchiveRecord& record) {
+    File* f = _segmentFile(seg);
+    if (!f) return false;
+    if (seg != _headSeg && _readPacked) {
+        if (!_loadBlock(seg, slot / TIME_BLOCK) || slot % TIME_BLOCK >= _blockLen) return false;
+        record = _blockCache[slot % TIME_BLOCK];
+        return true;
+    }
+    RecordSlot s;
+    f->seek(_slotOffset(slot), SeekSet);
+    if (f->read((uint8_t*)&s, SLOT_SIZE) != SLOT_SIZE || !_slotValid(s, seg * SEGMENT_RECORDS + slot)) {
+        return false;
+    }
+    record = s.record;
+    return true;
+}
+
+bool ArchiveManager::_dropOldestSegment(bool force) {
+    // Не затираем неотправленные данные: старейший сегмент удаляется,
+    // только если курсор pending-записей уже ушёл за его пределы
+    uint32_t end = (_firstSeg + 1) * SEGMENT_RECORDS;
+    if (_pendingHead < end && !force) {
+        Serial.println("[Archive] Архив заполнен неотправленными записями");
+        return false;
+    }
+    // Вычитаем удаляемые записи из счётчиков (один проход раз в сегмент)
+    uint32_t lost = 0;
+    _scan(_firstIndex(), [&](uint32_t idx, const ArchiveRecord& r) {
+        if (idx >= end) return false;
+        _countStatus(r.status, -1);
+        lost += r.status == 0;
+        return true;
+    });
+    if (lost) {
+        _retentionStats.overflow += lost;
+        Serial.printf("[Archive] Переполнение: вытеснено %lu неотправленных записей\n", (unsigned long)lost);
+    }
+    if (_readSeg == _firstSeg) {
+        _readFile.close();
+        _readSeg = UINT32_MAX;
+    }
+    if (_blockSeg == _firstSeg) _blockSeg = UINT32_MAX;
+    _fs->remove(_segmentPath(_firstSeg));
+    _fs->remove(_segmentPath(_firstSeg, ".csg"));
+    _fs->remove(_segmentPath(_firstSeg, ".cix"));
+    _statusLog.remove(_firstSeg);
+    _firstSeg++;
+    if (_tailStart < _firstIndex()) _tailStart = _firstIndex();
+    // Копии из удалённого сегмента больше не нужны
+    uint16_t gone = 0;
+    while (gone < _relocCount && _reloc[gone].index < _firstIndex()) gone++;
+    if (gone) {
+        _relocCount -= gone;
+        memmove(_reloc, _reloc + gone, sizeof(Relocation) * _relocCount);
+        _relocDirty = true;
+    }
+    if (_pendingHead < _firstIndex()) _advancePendingHead();
+    _saveState();
+    // Итоги живут, пока в архиве есть записи за эти сутки или раньше
+    uint32_t oldest = UINT32_MAX;
+    for (uint32_t s = _firstSeg; s <= _headSeg; s++) {
+        const TimeRange& r = _segTime[s % MAX_SEGMENTS];
+        if (r.min <= r.max && r.min < oldest) oldest = r.min;
+    }
+    if (oldest != UINT32_MAX) _rollup.prune(RollupStore::dayOf(oldest));
+    return true;
+}
+
+uint32_t ArchiveManager::_segmentLimit() const {
+    if (!_retention.maxRecords) return MAX_SEGMENTS;
+    uint32_t segs = (_retention.maxRecords + SEGMENT_RECORDS - 1) / SEGMENT_RECORDS;
+    // Не меньше двух: головной сегмент и хотя бы один закрытый
+    if (segs < 2) segs = 2;
+    return segs < MAX_SEGMENTS ? segs : MAX_SEGMENTS;
+}
+
+bool ArchiveManager::_segmentExpired(uint32_t seg) const {
+    if (!_retention.maxAgeDays || seg >= _headSeg) return false;
+    // Отсчёт от самой новой записи, а не от часов (они могут быть не выставлены).
+    // Ищем по всем сегментам: в голове может лежать старая запись, перенесённая уплотнением
+    uint32_t newest = 0;
+    for (uint32_t s = _firstSeg; s <= _headSeg; s++) {
+        const TimeRange& r = _segTime[s % MAX_SEGMENTS];
+        if (r.min <= r.max && r.max > newest) newest = r.max;
+    }
+    const TimeRange& r = _segTime[seg % MAX_SEGMENTS];
+    uint64_t maxAge = (uint64_t)_retention.maxAgeDays * 86400;
+    return r.min <= r.max && (uint64_t)r.max + maxAge < newest;
+}
+
+void ArchiveManager::setRetention(const ArchiveRetention& policy) {
+    Lock lock(_mutex);
+    _retention = policy;
+    Serial.printf("[Archive] Хранение: %lu сут., до %lu сегментов, pending %s\n",
+                  (unsigned long)policy.maxAgeDays, (unsigned long)_segmentLimit(),
+                  policy.dropPending ? "вытесняются" : "не вытесняются");
+}
+
+ArchiveRetention ArchiveManager::retention() const {
+    Lock lock(_mutex);
+    return _retention;
+}
+
+ArchiveRetentionStats ArchiveManager::retentionStats() const {
+    Lock lock(_mutex);
+    return _retentionStats;
+}
+
+size_t ArchiveManager::_segmentBytes(uint32_t seg) {
+    static const char* const exts[] = {".seg", ".csg", ".ack", ".cix"};
+    size_t bytes = 0;
+    for (const char* ext : exts) {
+        File f = _fs->open(_segmentPath(seg, ext), "r");
+        if (!f) continue;
+        bytes += f.size();
+        f.close();
+    }
+    return bytes;
+}
+
+bool ArchiveManager::compactStep() {
+    Lock lock(_mutex);
+    if (!_headFile) return false;
+    uint32_t watermark = (uint32_t)ARCHIVE_COMPACT_WATERMARK * _segmentLimit() / MAX_SEGMENTS;
+    bool expired = _segmentExpired(_firstSeg);
+    if (_headSeg - _firstSeg + 1 <= watermark && !expired) return false;
+    uint32_t t0  = micros();
+    uint32_t seg = _firstSeg;
+    uint32_t end = (seg + 1) * SEGMENT_RECORDS;
+    bool worked  = false;
+
+    if (_pendingHead < end) {
+        // Считаем pending в сегменте и берём первые для переноса
+        uint32_t idx[ARCHIVE_COMPACT_BATCH];
+        uint16_t n = 0, live = 0;
+        _scan(_pendingHead, [&](uint32_t i, const ArchiveRecord& r) {
+            if (i >= end) return false;
+            if (r.status != 0) return true;
+            if (n < ARCHIVE_COMPACT_BATCH) idx[n++] = i;
+            return ++live <= ARCHIVE_COMPACT_MAX_LIVE;
+        });
+        if (live > ARCHIVE_COMPACT_MAX_LIVE) return false;   // сегмент ещё «живой»
+
+        // Копия в голову и отметка оригинала уходят на флеш одним сбросом:
+        // после сбоя запись окажется максимум дважды, но не потеряется
+        for (uint16_t i = 0; i < n; i++) {
+            ArchiveRecord r;
+            if (!readRecord(idx[i], r) || !_append(r, false)) break;
+            // Копия сохраняет номер оригинала; если таблица полна — получает свой
+            if (_relocCount < RELOC_MAX) {
+                _reloc[_relocCount++] = {_endIndex() - 1, _origin(idx[i])};
+                _relocDirty = true;
+            }
+            _setStatus(idx[i], STATUS_MOVED);
+            _compactStats.relocated++;
+        }
+        flush();
+        worked = n > 0;
+    }
+
+    if (_pendingHead >= end && _firstSeg == seg) {
+        size_t bytes = _segmentBytes(seg);
+        if (flush() && _dropOldestSegment()) {
+            _compactStats.segments++;
+            _compactStats.bytes += bytes;
+            if (expired) _retentionStats.expired++;
+            Serial.printf("[Archive] Сегмент %lu освобождён %s: %u байт\n", (unsigned long)seg,
+                          expired ? "по возрасту" : "уплотнением", (unsigned)bytes);
+            worked = true;
+        }
+    }
+    if (worked) {
+        _compactStats.last_us   = micros() - t0;
+        _compactStats.total_us += _compactStats.last_us;
+    }
+    return worked;
+}
+
+File* ArchiveManager::_segmentFile(uint32_t seg) {
+    if (seg == _headSeg) return &_headFile;
+    if (seg < _firstSeg || seg > _headSeg) return nullptr;
+    if (_readSeg != seg) {
+        if (_readFile) _readFile.close();
+        // Сжатая версия, если есть, главнее несжатой
+        _readPacked = false;
+        _readFile   = _fs->open(_segmentPath(seg, ".csg"), "r");
+        if (_readFile) {
+            _readPacked = _readFile.read((uint8_t*)&_packHdr, sizeof(_packHdr)) == sizeof(_packHdr)
+                          && _packHdr.magic == PACKED_MAGIC && _packHdr.segment == seg;
+            if (!_readPacked) _readFile.close();
+        }
+        if (!_readPacked) {
+            _readFile = _fs->open(_segmentPath(seg), "r");
+            SegmentHeader hdr;
+            if (_readFile && _readFile.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr)
+                && hdr.version == 1) {
+                _readFile.close();
+                if (_upgradeSegment(seg)) _readFile = _fs->open(_segmentPath(seg), "r");
+            }
+        }
+        _readSeg = _readFile ? seg : UINT32_MAX;
+    }
+    return _readFile ? &_readFile : nullptr;
+}
+
+bool ArchiveManager::enqueue(const ArchiveRecord& record) {
+    if (_ingest.push(record)) return true;
+    _ingestDropped++;
     return false;
 }
-String ArchiveManager::getArchiveJson() {
-    String json = "[";
-    ArchiveRecord rec;
-    bool first = true;
-    // Перебираем все возможные слоты архива
-    for (uint16_t i = 0; i < MAX_RECORDS; i++) {
-        // readRecord у вас приватный, сделаем его публичным или друг — см. ниже
-        if (readRecord(i, rec)) {
-            if (!first) json += ",";
-            first = false;
-            json += "{";
-            json += "\"client_id\":" + String(rec.client_id) + ",";
-            json += "\"cow_id\":"    + String(rec.cow_id)    + ",";
-            json += "\"timestamp\":" + String(rec.timestamp) + ",";
-            json += "\"volume\":"    + String(rec.volume, 2) + ",";
-            json += "\"ec\":"        + String(rec.ec, 2)     + ",";
-            json += "\"status\":"    + String(rec.status);
-            json += "}";
+
+uint16_t ArchiveManager::drain(uint16_t max,
+                               std::function<bool(const ArchiveRecord&)> skip,
+                               std::function<void(const ArchiveRecord&)> added) {
+    uint16_t n = 0;
+    ArchiveRecord r;
+    // Мьютекс берём на каждую запись: читатели не ждут всю пачку
+    while (n < max && _ingest.peek(r)) {
+        if (!skip || !skip(r)) {
+            bool ok;
+            {
+                Lock lock(_mutex);
+                ok = _add(r, !_ingestRetry);
+            }
+            if (!ok) {
+                // Повтор той же записи не считается и не пишется в лог ещё раз
+                if (!_ingestRetry) Serial.println("[Archive] Запись из очереди приёма не принята, повтор позже");
+                _ingestRetry = true;
+                break;
+            }
+            if (added) added(r);
+        }
+        _ingest.pop(r);
+        _ingestRetry = false;
+        n++;
+    }
+    return n;
+}
+
+bool ArchiveManager::add(const ArchiveRecord& record) {
+    Lock lock(_mutex);
+    return _add(record, true);
+}
+
+bool ArchiveManager::_add(const ArchiveRecord& record, bool countReject) {
+    _full = false;
+    if (_append(record, true)) return true;
+    if (_full && countReject) _retentionStats.rejected++;
+    return false;
+}
+
+bool ArchiveManager::_append(const ArchiveRecord& record, bool rollup) {
+    if (!_headFile) return false;
+    // Буфер не пересекает границу сегмента: перед переходом к новому
+    // сегменту всё накопленное сбрасывается
+    if (_headCount + _batchCount >= SEGMENT_RECORDS) {
+        if (!flush() || !_sealHead()) return false;
+    }
+    if (_batchCount >= ARCHIVE_GROUP_COMMIT_MAX && !flush()) return false;
+
+    // Итоги — раньше записи в буфер: при сбросе архива сбрасываются и они
+    if (rollup && !_rollup.add(record) && (!flush() || !_rollup.add(record))) {
+        Serial.println("[Archive] Буфер итогов переполнен, запись в итоги не попала");
+    }
+
+    _markDirty();
+    uint16_t slot = _headCount + _batchCount;
+    _batch[_batchCount++] = record;
+    if (_cacheStats.capacity) {
+        _tailAt(_endIndex() - 1) = record;
+        if (_endIndex() - _tailStart > _cacheStats.capacity) _tailStart = _endIndex() - _cacheStats.capacity;
+    }
+    _headCows[slot] = record.cow_id;
+    _headTime[slot / TIME_BLOCK].extend(record.timestamp);
+    _segTime[_headSeg % MAX_SEGMENTS].extend(record.timestamp);
+    _countStatus(record.status, +1);
+    // Курсор стоял в конце (всё отправлено) — новая запись может сразу быть
+    // не pending, тогда проталкиваем его дальше
+    if (_pendingHead == _endIndex() - 1 && record.status != 0) _advancePendingHead();
+
+    // Запись уже принята в буфер; при ошибке сброса она останется там
+    if (_batchCount + _ackCount >= _groupMax) flush();
+    return true;
+}
+
+ArchiveFlushStats ArchiveManager::flushStats() const {
+    Lock lock(_mutex);
+    return _flushStats;
+}
+
+ArchiveCompactStats ArchiveManager::compactStats() const {
+    Lock lock(_mutex);
+    return _compactStats;
+}
+
+ArchiveCacheStats ArchiveManager::cacheStats() const {
+    Lock lock(_mutex);
+    return _cacheStats;
+}
+
+ArchiveCounters ArchiveManager::counters() const {
+    Lock lock(_mutex);
+    return _counters;
+}
+
+uint32_t ArchiveManager::firstIndex() const {
+    Lock lock(_mutex);
+    return _firstIndex();
+}
+
+uint32_t ArchiveManager::endIndex() const {
+    Lock lock(_mutex);
+    return _endIndex();
+}
+
+uint32_t ArchiveManager::pendingHead() const {
+    Lock lock(_mutex);
+    return _pendingHead;
+}
+
+RollupRow ArchiveManager::rollupRange(uint32_t cowId, uint32_t fromDay, uint32_t toDay,
+                                      std::function<bool(uint32_t, const RollupRow&)> fn) {
+    Lock lock(_mutex);
+    return _rollup.range(cowId, fromDay, toDay, fn);
+}
+
+void ArchiveManager::setGroupCommit(uint16_t maxRecords, uint32_t maxDelayMs) {
+    Lock lock(_mutex);
+    if (maxRecords < 1) maxRecords = 1;
+    if (maxRecords > ARCHIVE_GROUP_COMMIT_MAX) maxRecords = ARCHIVE_GROUP_COMMIT_MAX;
+    _groupMax     = maxRecords;
+    _groupDelayMs = maxDelayMs;
+    if (_batchCount + _ackCount >= _groupMax) flush();
+}
+
+void ArchiveManager::_markDirty() {
+    if (!_isDirty()) _dirtySince = millis();
+}
+
+void ArchiveManager::poll() {
+    Lock lock(_mutex);
+    if (_isDirty() && millis() - _dirtySince >= _groupDelayMs) flush();
+}
+
+bool ArchiveManager::flush() {
+    Lock lock(_mutex);
+    if (!_isDirty() || !_headFile) return true;
+    uint32_t t0 = micros();
+    bool ok = true;
+
+    // 1) Новые записи — одной последовательной записью в головной сегмент
+    if (_batchCount) {
+        // Слоты собираем порциями: номер и CRC считаются при записи
+        static const uint16_t CHUNK = 8;
+        RecordSlot chunk[CHUNK];
+        memset(chunk, 0, sizeof(chunk));
+        _headFile.seek(_slotOffset(_headCount), SeekSet);
+        for (uint16_t done = 0; ok && done < _batchCount; ) {
+            uint16_t n = _batchCount - done < CHUNK ? _batchCount - done : CHUNK;
+            for (uint16_t i = 0; i < n; i++) {
+                chunk[i].seq    = _flushedEnd() + done + i;
+                chunk[i].record = _batch[done + i];
+                chunk[i].crc    = _slotCrc(chunk[i]);
+            }
+            size_t bytes = (size_t)n * SLOT_SIZE;
+            ok = _headFile.write((const uint8_t*)chunk, bytes) == bytes;
+            done += n;
+        }
+        if (ok) {
+            _headFile.flush();
+            _headCount += _batchCount;
+            _flushStats.records += _batchCount;
+            _batchCount = 0;
+        } else {
+            Serial.println("[Archive] Ошибка записи (нет места в LittleFS?)");
+            ok = false;
+        }
+    }
+    // Итоги — только когда их записи уже на флеше
+    if (ok) _rollup.flush(_flushedEnd());
+
+    // 2) Смены статусов — дописываем в журналы подтверждений; тела записей
+    // не трогаем. Обычно все подтверждения пачки лежат в 1–2 сегментах
+    if (ok && _ackCount) {
+        for (uint16_t i = 0; i < _ackCount; i++) {
+            uint32_t seg = _acks[i].index / SEGMENT_RECORDS;
+            bool done = seg < _firstSeg;    // сегмент уже удалён
+            for (uint16_t j = 0; j < i && !done; j++) {
+                done = _acks[j].index / SEGMENT_RECORDS == seg;
+            }
+            if (!done && !_statusLog.append(seg, _acks, _ackCount)) {
+                Serial.println("[Archive] Ошибка записи журнала подтверждений");
+                ok = false;
+                break;
+            }
+        }
+        if (ok) {
+            _flushStats.acks += _ackCount;
+            _ackCount = 0;
         }
     }
+
+    // 3) Курсор и счётчики — один раз на весь сброс. Новые записи сами по
+    // себе состояние не меняют: при загрузке хвост досчитывается
+    if (ok && _stateDirty) _saveState();
+    // 4) Курсоры всех потребителей — одним файлом
+    if (ok && _consumers.dirty() && !_consumers.save()) {
+        Serial.println("[Archive] Ошибка записи курсоров потребителей");
+        ok = false;
+    }
+    // 5) Пары «копия → оригинал» после уплотнения
+    if (ok && _relocDirty && !_saveRelocations()) {
+        Serial.println("[Archive] Ошибка записи таблицы переносов");
+        ok = false;
+    }
+
+    uint32_t dt = micros() - t0;
+    _flushStats.flushes++;
+    _flushStats.last_us = dt;
+    if (dt > _flushStats.max_us) _flushStats.max_us = dt;
+    _dirtySince = millis();
+    return ok;
+}
+
+ArchiveManager::StatusChange* ArchiveManager::_findAck(uint32_t index) {
+    for (uint16_t i = 0; i < _ackCount; i++) {
+        if (_acks[i].index == index) return &_acks[i];
+    }
+    return nullptr;
+}
+
+void ArchiveManager::_overlayStatus(uint32_t index, ArchiveRecord& record,
+                                    const ArchiveStatusLog::Map* map) const {
+    if (map) {
+        uint8_t st = map->get(index % SEGMENT_RECORDS);
+        if (st != ArchiveStatusLog::NONE) record.status = st;
+    }
+    for (uint16_t i = 0; i < _ackCount; i++) {
+        if (_acks[i].index == index) {
+            record.status = _acks[i].status;
+            return;
+        }
+    }
+}
+
+bool ArchiveManager::readRecord(uint32_t index, ArchiveRecord& record) {
+    Lock lock(_mutex);
+    return _readAny(index, record) && record.status != STATUS_MOVED;
+}
+
+bool ArchiveManager::_readAny(uint32_t index, ArchiveRecord& record) {
+    const ArchiveRecord* r = _recordAt(index, record);
+    if (!r) return false;
+    if (r != &record) record = *r;
+    return true;
+}
+
+const ArchiveRecord* ArchiveManager::_recordAt(uint32_t index, ArchiveRecord& scratch) {
+    if (index < _firstIndex() || index >= _endIndex()) return nullptr;
+    if (_tailCached(index)) {
+        _cacheStats.hits++;
+        return &_tailAt(index);
+    }
+    if (index >= _flushedEnd()) return &_batch[index - _flushedEnd()];
+    if (_cacheStats.capacity) _cacheStats.misses++;
+    uint32_t seg  = index / SEGMENT_RECORDS;
+    uint16_t slot = index % SEGMENT_RECORDS;
+    File* f = _segmentFile(seg);
+    if (!f) return nullptr;
+    ArchiveRecord* r = &scratch;
+    if (seg != _headSeg && _readPacked) {
+        // Сжатый сегмент — прямо из распакованного блока
+        if (!_loadBlock(seg, slot / TIME_BLOCK) || slot % TIME_BLOCK >= _blockLen) return nullptr;
+        r = &_blockCache[slot % TIME_BLOCK];
+    } else if (!_readSlot(seg, slot, scratch)) {
+        return nullptr;
+    }
+    _overlayStatus(index, *r, _statusLog.map(seg));
+    return r;
+}
+
+void ArchiveManager::_scan(uint32_t from, std::function<bool(uint32_t, const ArchiveRecord&)> fn) {
+    if (from < _firstIndex()) from = _firstIndex();
+    uint32_t end = _flushedEnd();
+    // С флеша — только то, чего нет в кэше хвоста
+    if (_cacheStats.capacity && _tailStart < end) end = _tailStart > from ? _tailStart : from;
+    RecordSlot chunk[SCAN_CHUNK];
+    while (from < end) {
+        uint32_t seg  = from / SEGMENT_RECORDS;
+        uint32_t last = (seg + 1) * SEGMENT_RECORDS;
+        if (last > end) last = end;
+        File* f = _segmentFile(seg);
+        if (!f) {                       // сегмент пропал — переходим к следующему
+            from = last;
+            continue;
+        }
+        // Колбэк мог прочитать другие сегменты и вытеснить карту статусов
+        // этого — берём её заново перед каждой записью
+        if (seg != _headSeg && _readPacked) {
+            // Сжатый сегмент — записи отдаются прямо из распакованного блока;
+            // блок перечитывается, только если колбэк успел его сменить
+            for (; from < last; from++) {
+                uint16_t slot = from % SEGMENT_RECORDS;
+                if (!_loadBlock(seg, slot / TIME_BLOCK) || slot % TIME_BLOCK >= _blockLen) {
+                    from = last;
+                    break;
+                }
+                if (_cacheStats.capacity) _cacheStats.misses++;
+                ArchiveRecord& r = _blockCache[slot % TIME_BLOCK];
+                _overlayStatus(from, r, _statusLog.map(seg));
+                if (!fn(from, r)) return;
+            }
+            continue;
+        }
+        // Несжатый — пачками по SCAN_CHUNK слотов одним чтением
+        while (from < last) {
+            uint16_t n = last - from < SCAN_CHUNK ? last - from : SCAN_CHUNK;
+            // Колбэк мог прочитать другой сегмент — файл берём заново
+            f = _segmentFile(seg);
+            if (!f || !f->seek(_slotOffset(from % SEGMENT_RECORDS), SeekSet)
+                || f->read((uint8_t*)chunk, (size_t)n * SLOT_SIZE) != (size_t)n * SLOT_SIZE) {
+                from = last;
+                break;
+            }
+            for (uint16_t i = 0; i < n; i++, from++) {
+                if (!_slotValid(chunk[i], from)) continue;     // повреждённую запись пропускаем
+                if (_cacheStats.capacity) _cacheStats.misses++;
+                _overlayStatus(from, chunk[i].record, _statusLog.map(seg));
+                if (!fn(from, chunk[i].record)) return;
+            }
+        }
+    }
+    // Кэш хвоста в PSRAM
+    for (; _tailCached(from); from++) {
+        _cacheStats.hits++;
+        if (!fn(from, _tailAt(from))) return;
+    }
+    // Хвост, ещё не сброшенный на флеш
+    for (; from < _endIndex(); from++) {
+        if (!fn(from, _batch[from - _flushedEnd()])) return;
+    }
+}
+
+bool ArchiveManager::getNextPending(uint32_t &outIndex, ArchiveRecord &outRec) {
+    Lock lock(_mutex);
+    // Инвариант: под курсором лежит pending-запись либо курсор == endIndex()
+    if (_pendingHead >= _endIndex()) return false;
+    if (!readRecord(_pendingHead, outRec)) return false;
+    if (outRec.status != 0) {          // статус сменили в обход updateStatus()
+        _markDirty();
+        _advancePendingHead();
+        _stateDirty = true;
+        if (_pendingHead >= _endIndex() || !readRecord(_pendingHead, outRec)) return false;
+    }
+    outIndex = _pendingHead;
+    return true;
+}
+
+void ArchiveManager::_loadRelocations() {
+    _relocCount = 0;
+    _relocDirty = false;
+    File f = _fs->open(_dir + "/reloc", "r");
+    if (!f) return;
+    uint32_t hdr[2];
+    if (f.read((uint8_t*)hdr, sizeof(hdr)) == sizeof(hdr) && hdr[0] == RELOC_MAGIC) {
+        Relocation r;
+        for (uint32_t i = 0; i < hdr[1] && f.read((uint8_t*)&r, sizeof(r)) == sizeof(r); i++) {
+            // Копия удалена вместе с сегментом или потеряна с несброшенным хвостом
+            if (r.index < _firstIndex() || r.index >= _flushedEnd()) continue;
+            if (_relocCount < RELOC_MAX) _reloc[_relocCount++] = r;
+        }
+    }
+    f.close();
+}
+
+bool ArchiveManager::_saveRelocations() {
+    File f = _fs->open(_dir + "/reloc", "w");
+    if (!f) return false;
+    uint32_t hdr[2] = {RELOC_MAGIC, _relocCount};
+    size_t bytes = sizeof(Relocation) * _relocCount;
+    bool ok = f.write((const uint8_t*)hdr, sizeof(hdr)) == sizeof(hdr)
+           && f.write((const uint8_t*)_reloc, bytes) == bytes;
+    f.close();
+    if (ok) _relocDirty = false;
+    return ok;
+}
+
+uint32_t ArchiveManager::_origin(uint32_t index) const {
+    if (!_relocCount || index < _reloc[0].index) return index;
+    uint16_t lo = 0, hi = _relocCount;
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+        if (_reloc[mid].index < index) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < _relocCount && _reloc[lo].index == index ? _reloc[lo].origin : index;
+}
+
+uint64_t ArchiveManager::seqOf(uint32_t index) const {
+    Lock lock(_mutex);
+    return _origin(index);
+}
+
+size_t ArchiveManager::readSince(uint64_t& seq, ArchiveRecord* out, uint64_t* outSeq, size_t max) {
+    Lock lock(_mutex);
+    return _readSince(seq, out, outSeq, max, _flushedEnd());
+}
+
+size_t ArchiveManager::_readSince(uint64_t& seq, ArchiveRecord* out, uint64_t* outSeq, size_t max,
+                                  uint32_t end) {
+    if (!max) return 0;
+    uint32_t first = _firstIndex();
+    // Номер из будущего: получатель синхронизировался с прежним архивом
+    uint32_t from  = seq > end ? 0 : (uint32_t)seq;
+    size_t n = 0;
+
+    // 1) Получатель отстал за удалённые сегменты: сначала копии, чьи
+    // оригиналы он не получил, — по возрастанию номера
+    while (from < first && n < max) {
+        const Relocation* next = nullptr;
+        for (uint16_t i = 0; i < _relocCount; i++) {
+            const Relocation& r = _reloc[i];
+            if (r.origin >= from && r.origin < first && r.index < end
+                && (!next || r.origin < next->origin
+                    || (r.origin == next->origin && r.index > next->index))) next = &r;
+        }
+        if (!next) break;
+        from = next->origin + 1;
+        if (!readRecord(next->index, out[n])) continue;
+        if (outSeq) outSeq[n] = next->origin;
+        n++;
+    }
+    if (n == max && from < first) {
+        seq = from;
+        return n;
+    }
+    if (from < first) from = first;
+
+    // 2) Записи по порядку; копии пропускаются — оригинал либо ещё в
+    // архиве, либо выдан на шаге 1
+    seq = end;
+    _scan(from, [&](uint32_t index, const ArchiveRecord& rec) {
+        if (index >= end) return false;
+        if (n == max) {
+            seq = index;
+            return false;
+        }
+        if (_origin(index) != index) return true;
+        out[n] = rec;
+        if (rec.status == STATUS_MOVED) out[n].status = 0;   // перенесён неотправленным
+        if (outSeq) outSeq[n] = index;
+        n++;
+        return true;
+    });
+    return n;
+}
+
+int8_t ArchiveManager::findConsumer(const char* name) const {
+    Lock lock(_mutex);
+    return _consumers.find(name);
+}
+
+int8_t ArchiveManager::openConsumer(const char* name) {
+    Lock lock(_mutex);
+    int8_t id = _consumers.find(name);
+    if (id >= 0) return id;
+    id = _consumers.open(name, _firstIndex());
+    if (id >= 0) _markDirty();
+    return id;
+}
+
+bool ArchiveManager::closeConsumer(const char* name) {
+    Lock lock(_mutex);
+    if (!_consumers.close(name)) return false;
+    _markDirty();
+    return true;
+}
+
+bool ArchiveManager::consumerNext(uint8_t id, uint32_t& outIndex, ArchiveRecord& outRec) {
+    Lock lock(_mutex);
+    if (id >= _consumers.count()) return false;
+    // Курсор — номер, как у readSince(): копия уплотнения выдаётся, только
+    // если оригинал удалён раньше, чем потребитель до него дошёл
+    uint64_t seq = _consumers.cursor(id), number;
+    if (!_readSince(seq, &outRec, &number, 1, _endIndex())) {
+        // Остались одни копии, оригиналы которых уже выданы, — подтверждать нечего
+        consumerAck(id, (uint32_t)seq);
+        return false;
+    }
+    outIndex = (uint32_t)number;
+    return true;
+}
+
+void ArchiveManager::consumerAck(uint8_t id, uint32_t end) {
+    Lock lock(_mutex);
+    if (id >= _consumers.count()) return;
+    if (end > _endIndex()) end = _endIndex();
+    if (end <= _consumers.cursor(id)) return;
+    _markDirty();
+    _consumers.ack(id, end);
+}
+
+uint32_t ArchiveManager::consumerCursor(uint8_t id) const {
+    Lock lock(_mutex);
+    if (id >= _consumers.count()) return _endIndex();
+    uint32_t c = _consumers.cursor(id);
+    return c < _firstIndex() ? _firstIndex() : c;
+}
+
+uint32_t ArchiveManager::consumerLag(uint8_t id) const {
+    Lock lock(_mutex);
+    uint32_t c = consumerCursor(id);
+    return c < _endIndex() ? _endIndex() - c : 0;
+}
+
+const char* ArchiveManager::consumerName(uint8_t id) const {
+    Lock lock(_mutex);
+    return _consumers.name(id);
+}
+
+uint8_t ArchiveManager::consumerCount() const {
+    Lock lock(_mutex);
+    return _consumers.count();
+}
+
+String ArchiveManager::getArchiveJson() {
+    Lock lock(_mutex);
+    String json = "[";
+    char buf[EXPORT_JSON_MAX];
+    _visit(_firstIndex(), ArchiveFilter(), [&](uint32_t, const ArchiveRecord& r) {
+        if (json.length() > 1) json += ',';
+        int n = recordJson(r, buf, sizeof(buf));
+        if (n > 0 && (size_t)n < sizeof(buf)) json += buf;
+        return true;
+    });
     json += "]";
     return json;
 }
-void ArchiveManager::updateStatus(uint16_t index, uint8_t status) {
-    ArchiveRecord record;
-    if (!readRecord(index, record)) return;
-    record.status = status;
-    writeRecord(index, record);
-    EEPROM.commit();
+
+int ArchiveManager::recordJson(const ArchiveRecord& rec, char* buf, size_t size) {
+    return snprintf(buf, size,
+                    "{\"client_id\":%lu,\"cow_id\":%lu,\"timestamp\":%lu,"
+                    "\"volume\":%.2f,\"ec\":%.2f,\"status\":%u}",
+                    (unsigned long)rec.client_id, (unsigned long)rec.cow_id,
+                    (unsigned long)rec.timestamp, rec.volume, rec.ec, rec.status);
+}
+
+size_t ArchiveManager::exportJson(uint32_t& cursor, char* buf, size_t size, bool& first,
+                                  const ArchiveFilter& filter) {
+    Lock lock(_mutex);
+    size_t len  = 0;
+    bool   full = false;
+    _visit(cursor, filter, [&](uint32_t index, const ArchiveRecord& rec) {
+        // snprintf пишет завершающий ноль, поэтому запись влезает при n < size - len
+        size_t sep = first ? 0 : 1;
+        int n = size - len > sep ? recordJson(rec, buf + len + sep, size - len - sep) : -1;
+        if (n < 0 || (size_t)n >= size - len - sep) {
+            full = true;
+            return false;
+        }
+        if (sep) buf[len] = ',';
+        len   += sep + n;
+        first  = false;
+        cursor = index + 1;
+        return true;
+    });
+    // Обход дошёл до конца (в т.ч. через пропущенные блоки) — экспорт окончен
+    if (!full) cursor = _endIndex();
+    return len;
+}
+
+// Поля двоичной выгрузки — little-endian, как в памяти ESP32
+static uint8_t* put16(uint8_t* p, uint16_t v) {
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+static uint8_t* put32(uint8_t* p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+size_t ArchiveManager::exportBinaryHeader(uint8_t* buf, uint32_t start, uint32_t end) {
+    uint8_t* p = put32(buf, EXPORT_MAGIC);
+    p = put16(p, EXPORT_VERSION);
+    p = put16(p, EXPORT_RECORD_SIZE);
+    p = put32(p, start);
+    p = put32(p, end);
+    return p - buf;
+}
+
+size_t ArchiveManager::exportBinary(uint32_t& cursor, uint8_t* buf, size_t size,
+                                    const ArchiveFilter& filter) {
+    Lock lock(_mutex);
+    if (size < EXPORT_BLOCK_MIN) return 0;
+    uint16_t max = (size - 6) / EXPORT_RECORD_SIZE > 0xFFFF ? 0xFFFF : (size - 6) / EXPORT_RECORD_SIZE;
+    uint16_t n   = 0;
+    uint8_t* p   = buf + 2;
+    _visit(cursor, filter, [&](uint32_t index, const ArchiveRecord& rec) {
+        if (n == max) return false;
+        p = put32(p, index);
+        p = put32(p, rec.client_id);
+        p = put32(p, rec.cow_id);
+        p = put32(p, rec.timestamp);
+        memcpy(p, &rec.volume, 4);
+        memcpy(p + 4, &rec.ec, 4);
+        p[8] = rec.status;
+        p += 9;
+        n++;
+        cursor = index + 1;
+        return true;
+    });
+    // Обход дошёл до конца (в т.ч. через пропущенные блоки) — выгрузка окончена
+    if (n < max) cursor = _endIndex();
+    if (!n) return 0;
+    put16(buf, n);
+    p = put32(p, Crc::crc32(buf, p - buf));
+    return p - buf;
+}
+
+size_t ArchiveManager::exportBinaryTrailer(uint8_t* buf, uint32_t next) {
+    uint8_t* p = put16(buf, 0);
+    p = put32(p, next);
+    p = put32(p, Crc::crc32(buf, p - buf));
+    return p - buf;
+}
+
+void ArchiveManager::visit(const ArchiveFilter& filter,
+                           std::function<bool(uint32_t, const ArchiveRecord&)> fn, uint32_t cursor) {
+    Lock lock(_mutex);
+    _visit(cursor, filter, fn);
+}
+
+void ArchiveManager::_visit(uint32_t cursor, const ArchiveFilter& filter,
+                            std::function<bool(uint32_t, const ArchiveRecord&)> fn) {
+    // Время и корова отсекаются индексами, остальное — проверкой на месте
+    auto match = [&](uint32_t idx, const ArchiveRecord& r) {
+        return r.status == STATUS_MOVED || !filter.matches(r) || fn(idx, r);
+    };
+    if (filter.cow_id != ArchiveFilter::ANY_COW) {
+        _cowHistory(cursor, filter.cow_id, match);
+    } else if (filter.from == 0 && filter.to == UINT32_MAX) {
+        _scan(cursor, match);
+    } else {
+        _query(cursor, filter.from, filter.to, match);
+    }
+}
+
+void ArchiveManager::query(uint32_t from, uint32_t to,
+                           std::function<bool(uint32_t, const ArchiveRecord&)> fn) {
+    Lock lock(_mutex);
+    _query(_firstIndex(), from, to, [&](uint32_t idx, const ArchiveRecord& r) {
+        return r.status == STATUS_MOVED || fn(idx, r);
+    });
+}
+
+void ArchiveManager::_query(uint32_t cursor, uint32_t from, uint32_t to,
+                            std::function<bool(uint32_t, const ArchiveRecord&)> fn) {
+    if (cursor < _firstIndex()) cursor = _firstIndex();
+    uint32_t end = _endIndex();
+    while (cursor < end) {
+        uint32_t seg    = cursor / SEGMENT_RECORDS;
+        uint32_t segEnd = (seg + 1) * SEGMENT_RECORDS;
+        if (!_segTime[seg % MAX_SEGMENTS].overlaps(from, to)) {
+            cursor = segEnd;
+            continue;
+        }
+        // Блоки головного сегмента — в RAM, закрытых — одно чтение из tindex.
+        // Без записи индекса сегмент просматривается целиком
+        TimeIndexEntry e;
+        const TimeRange* blocks = _headTime;
+        // Сегмент в кэше хвоста просматриваем целиком — это дешевле чтения tindex
+        if (seg != _headSeg) blocks = !_tailCached(cursor) && _readTimeEntry(seg, e) ? e.blocks : nullptr;
+
+        while (cursor < segEnd && cursor < end) {
+            uint16_t block    = (cursor % SEGMENT_RECORDS) / TIME_BLOCK;
+            uint32_t blockEnd = seg * SEGMENT_RECORDS + (uint32_t)(block + 1) * TIME_BLOCK;
+            if (blockEnd > segEnd) blockEnd = segEnd;
+            if (blocks && !blocks[block].overlaps(from, to)) {
+                cursor = blockEnd;
+                continue;
+            }
+            bool stop = false;
+            _scan(cursor, [&](uint32_t idx, const ArchiveRecord& r) {
+                if (idx >= blockEnd) return false;
+                if (r.timestamp >= from && r.timestamp <= to && !fn(idx, r)) {
+                    stop = true;
+                    return false;
+                }
+                return true;
+            });
+            if (stop) return;
+            cursor = blockEnd;
+        }
+    }
+}
+
+void ArchiveManager::updateStatus(uint32_t index, uint8_t status) {
+    Lock lock(_mutex);
+    if (status != STATUS_MOVED) _setStatus(index, status);
+}
+
+void ArchiveManager::_setStatus(uint32_t index, uint8_t status) {
+    if (index < _firstIndex() || index >= _endIndex()) return;
+    uint8_t old = 0;
+
+    if (index >= _flushedEnd()) {
+        // Запись ещё в буфере — меняем прямо там
+        ArchiveRecord& r = _batch[index - _flushedEnd()];
+        old = r.status;
+        if (old == status || old == STATUS_MOVED) return;
+        r.status = status;
+    } else if (StatusChange* ch = _findAck(index)) {
+        old = ch->status;
+        if (old == status || old == STATUS_MOVED) return;
+        ch->status = status;
+    } else {
+        // Только узнаём прежний статус; на флеш смена уйдёт при сбросе
+        if (!_storedStatus(index, old) || old == status || old == STATUS_MOVED) return;
+        // Буфер подтверждений полон и не сбрасывается (нет места?) — смену
+        // не принимаем, иначе запись уйдёт за границу _acks
+        if (_ackCount >= ARCHIVE_GROUP_COMMIT_MAX && !flush()) return;
+        _markDirty();
+        _acks[_ackCount++] = {index, status};
+    }
+    if (_tailCached(index)) _tailAt(index).status = status;
+    _countStatus(old, -1);
+    _countStatus(status, +1);
+
+    if (status == 0 && index < _pendingHead) {
+        // Запись вернули в очередь — курсор откатывается к ней
+        _pendingHead = index;
+    } else if (status != 0 && index == _pendingHead) {
+        _advancePendingHead();
+    }
+    _markDirty();
+    _stateDirty = true;
+    if (_batchCount + _ackCount >= _groupMax) flush();
 }
 
 void ArchiveManager::dumpAll(Stream& out) {
-    for (uint16_t i = 0; i < MAX_RECORDS; i++) {
-        ArchiveRecord r;
-        if (readRecord(i, r)) {
-            out.printf("ID: %lu, Time: %lu, Volume: %.2f, EC: %.2f, Status: %u\n",r.cow_id, r.timestamp, r.volume, r.ec, r.status);
+    Lock lock(_mutex);
+    _scan(_firstIndex(), [&](uint32_t, const ArchiveRecord& r) {
+        if (r.status == STATUS_MOVED) return true;
+        out.printf("ID: %lu, Time: %lu, Volume: %.2f, EC: %.2f, Status: %u\n",
+                   (unsigned long)r.cow_id, (unsigned long)r.timestamp, r.volume, r.ec, r.status);
+        return true;
+    });
+}
+
+bool ArchiveManager::_writeCowIndex(uint32_t seg, CowIndexEntry* e, uint16_t count) {
+    std::sort(e, e + count, [](const CowIndexEntry& a, const CowIndexEntry& b) {
+        return a.cow_id != b.cow_id ? a.cow_id < b.cow_id : a.slot < b.slot;
+    });
+    bool ok = false;
+    File f = _fs->open(_segmentPath(seg, ".cix"), "w");
+    if (f) {
+        size_t bytes = (size_t)count * sizeof(CowIndexEntry);
+        ok = f.write((const uint8_t*)e, bytes) == bytes;
+        f.close();
+        if (!ok) _fs->remove(_segmentPath(seg, ".cix"));
+    }
+    return ok;
+}
+
+bool ArchiveManager::_sealCowIndex() {
+    CowIndexEntry* e = new (std::nothrow) CowIndexEntry[_headCount ? _headCount : 1];
+    if (!e) return false;
+    uint16_t count = 0;
+    for (uint16_t slot = 0; slot < _headCount; slot++) {
+        if (_headCows[slot] != NO_COW) e[count++] = {_headCows[slot], slot, 0};
+    }
+    bool ok = _writeCowIndex(_headSeg, e, count);
+    delete[] e;
+    return ok;
+}
+
+bool ArchiveManager::_buildCowIndex(uint32_t seg) {
+    CowIndexEntry* e = new (std::nothrow) CowIndexEntry[SEGMENT_RECORDS];
+    if (!e) return false;
+    uint16_t count = 0;
+    uint32_t end = (seg + 1) * SEGMENT_RECORDS;
+    // _scan() пропускает битые слоты — номер слота храним явно, а не позицией
+    _scan(seg * SEGMENT_RECORDS, [&](uint32_t idx, const ArchiveRecord& r) {
+        if (idx >= end) return false;
+        e[count++] = {r.cow_id, (uint16_t)(idx % SEGMENT_RECORDS), 0};
+        return true;
+    });
+    bool ok = _writeCowIndex(seg, e, count);
+    delete[] e;
+    Serial.printf("[Archive] Индекс коров сегмента %lu перестроен (%u записей)\n",
+                  (unsigned long)seg, count);
+    return ok;
+}
+
+bool ArchiveManager::_cowSegment(uint32_t seg, uint32_t cowId, uint32_t from, bool reverse,
+                                 std::function<bool(uint32_t)> fn) {
+    uint32_t base = seg * SEGMENT_RECORDS;
+    uint32_t limit = from <= base ? 0 : from - base;   // граничный слот
+    if (limit > SEGMENT_RECORDS) limit = SEGMENT_RECORDS;
+
+    // Головной сегмент — по массиву cow_id в RAM
+    if (seg == _headSeg) {
+        uint32_t n = _headCount + _batchCount;
+        if (reverse) {
+            for (uint32_t slot = limit < n ? limit : n; slot-- > 0; ) {
+                if (_headCows[slot] == cowId && !fn(base + slot)) return false;
+            }
+        } else {
+            for (uint32_t slot = limit; slot < n; slot++) {
+                if (_headCows[slot] == cowId && !fn(base + slot)) return false;
+            }
+        }
+        return true;
+    }
+
+    String path = _segmentPath(seg, ".cix");
+    File f = _fs->open(path, "r");
+    if (!f && _buildCowIndex(seg)) f = _fs->open(path, "r");
+    if (!f) {
+        // Индекс не построить (нет памяти) — перебираем записи сегмента
+        for (uint32_t i = 0; i < SEGMENT_RECORDS; i++) {
+            uint32_t slot = reverse ? SEGMENT_RECORDS - 1 - i : i;
+            if (reverse ? slot >= limit : slot < limit) continue;
+            ArchiveRecord r;
+            if (readRecord(base + slot, r) && r.cow_id == cowId && !fn(base + slot)) return false;
+        }
+        return true;
+    }
+
+    // Двоичный поиск первой пары >= (cowId, limit)
+    CowIndexEntry e;
+    auto entryAt = [&](uint32_t i) {
+        return f.seek(i * sizeof(CowIndexEntry), SeekSet)
+               && f.read((uint8_t*)&e, sizeof(e)) == sizeof(e);
+    };
+    uint32_t lo = 0, hi = f.size() / sizeof(CowIndexEntry);
+    uint32_t count = hi;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (!entryAt(mid)) break;
+        if (e.cow_id < cowId || (e.cow_id == cowId && e.slot < limit)) lo = mid + 1;
+        else hi = mid;
+    }
+
+    bool more = true;
+    if (reverse) {
+        for (uint32_t i = lo; more && i-- > 0; ) {
+            if (!entryAt(i) || e.cow_id != cowId) break;
+            more = fn(base + e.slot);
+        }
+    } else {
+        // Пары коровы лежат подряд — читаем последовательно без seek
+        f.seek(lo * sizeof(CowIndexEntry), SeekSet);
+        for (uint32_t i = lo; more && i < count; i++) {
+            if (f.read((uint8_t*)&e, sizeof(e)) != sizeof(e) || e.cow_id != cowId) break;
+            more = fn(base + e.slot);
         }
     }
+    f.close();
+    return more;
+}
+
+void ArchiveManager::_cowHistory(uint32_t cursor, uint32_t cowId,
+                                 std::function<bool(uint32_t, const ArchiveRecord&)> fn) {
+    if (cursor < _firstIndex()) cursor = _firstIndex();
+    for (uint32_t seg = cursor / SEGMENT_RECORDS; seg <= _headSeg; seg++) {
+        bool more = _cowSegment(seg, cowId, cursor, false, [&](uint32_t idx) {
+            ArchiveRecord scratch;
+            const ArchiveRecord* r = _recordAt(idx, scratch);
+            return !r || fn(idx, *r);
+        });
+        if (!more) return;
+    }
+}
+
+void ArchiveManager::cowHistory(uint32_t cowId,
+                                std::function<bool(uint32_t, const ArchiveRecord&)> fn) {
+    Lock lock(_mutex);
+    _cowHistory(_firstIndex(), cowId, [&](uint32_t idx, const ArchiveRecord& r) {
+        return r.status == STATUS_MOVED || fn(idx, r);
+    });
+}
+
+size_t ArchiveManager::lastMilkings(uint32_t cowId, ArchiveRecord* out, size_t max) {
+    Lock lock(_mutex);
+    size_t n = 0;
+    for (uint32_t seg = _headSeg + 1; n < max && seg-- > _firstSeg; ) {
+        _cowSegment(seg, cowId, _endIndex(), true, [&](uint32_t idx) {
+            if (readRecord(idx, out[n])) n++;
+            return n < max;
+        });
+    }
+    return n;
 }
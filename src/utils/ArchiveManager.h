@@ -2,7 +2,15 @@
 #define ARCHIVE_MANAGER_H
 
 #include <Arduino.h>
-#include <EEPROM.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "ArchiveConfig.h"
+#include "ArchiveConsumers.h"
+#include "ArchiveStatusLog.h"
+#include "RollupStore.h"
+#include "SpscQueue.h"
 
 struct ArchiveRecord {
     uint32_t   client_id;   // номер ПУМ
@@ -13,48 +21,667 @@ struct ArchiveRecord {
     uint8_t  status; // 0 = pending, 1 = sent, 2 = error
 };
 
+/**
+ * @brief Счётчики записей архива по статусам.
+ */
+struct ArchiveCounters {
+    uint32_t total;
+    uint32_t pending;
+    uint32_t sent;
+    uint32_t error;
+};
+
+/**
+ * @brief Фильтр обхода ArchiveManager::visit() и выгрузки exportJson().
+ */
+struct ArchiveFilter {
+    static const uint32_t ANY_COW    = UINT32_MAX;
+    static const uint32_t ANY_CLIENT = UINT32_MAX;
+    static const uint8_t  ANY_STATUS = 0xFF;
+    uint32_t from      = 0;            ///< timestamp >= from
+    uint32_t to        = UINT32_MAX;   ///< timestamp <= to
+    uint32_t cow_id    = ANY_COW;      ///< только эта корова (через индекс по cow_id)
+    uint32_t client_id = ANY_CLIENT;   ///< только записи этого ПУМ
+    uint8_t  status    = ANY_STATUS;   ///< только записи с этим статусом
+    bool matches(const ArchiveRecord& r) const {
+        return r.timestamp >= from && r.timestamp <= to
+               && (cow_id == ANY_COW || r.cow_id == cow_id)
+               && (client_id == ANY_CLIENT || r.client_id == client_id)
+               && (status == ANY_STATUS || r.status == status);
+    }
+};
+
+/**
+ * @brief Статистика сбросов группового коммита на флеш.
+ */
+struct ArchiveFlushStats {
+    uint32_t flushes;   ///< Сколько раз буфер сбрасывался на флеш
+    uint32_t records;   ///< Записей записано сбросами
+    uint32_t acks;      ///< Смен статуса записано сбросами
+    uint32_t last_us;   ///< Длительность последнего сброса, мкс
+    uint32_t max_us;    ///< Максимальная длительность сброса, мкс
+};
+
+/**
+ * @brief Статистика кэша хвоста архива.
+ */
+struct ArchiveCacheStats {
+    uint32_t capacity;   ///< Ёмкость кэша, записей (0 — кэша нет)
+    uint32_t hits;       ///< Записей отдано из кэша
+    uint32_t misses;     ///< Записей прочитано с флеша
+    uint32_t hitPercent() const {
+        uint64_t all = (uint64_t)hits + misses;
+        return all ? (uint32_t)((uint64_t)hits * 100 / all) : 0;
+    }
+};
+
+/**
+ * @brief Статистика уплотнения архива.
+ */
+struct ArchiveCompactStats {
+    uint32_t segments;    ///< Освобождено сегментов
+    uint32_t relocated;   ///< Перенесено pending-записей в голову архива
+    uint32_t bytes;       ///< Освобождено байт на флеше
+    uint32_t last_us;     ///< Длительность последнего шага, мкс
+    uint32_t total_us;    ///< Суммарное время уплотнения, мкс
+};
+
+/**
+ * @brief Политика хранения архива (ArchiveManager::setRetention()).
+ * Нули — без ограничения, поведение как без политики.
+ */
+struct ArchiveRetention {
+    uint32_t maxAgeDays  = 0;      ///< Хранить записи не старше (от самой новой записи архива), суток
+    uint32_t maxRecords  = 0;      ///< Хранить не больше стольких записей (с точностью до сегмента)
+    bool     dropPending = false;  ///< Переполнение: вытеснять неотправленные (счёт в overflow), а не отказывать в приёме
+};
+
+/**
+ * @brief Статистика политики хранения.
+ */
+struct ArchiveRetentionStats {
+    uint32_t expired;    ///< Сегментов удалено по возрасту
+    uint32_t evicted;    ///< Сегментов вытеснено по размеру
+    uint32_t overflow;   ///< Неотправленных записей потеряно при переполнении
+    uint32_t rejected;   ///< Записей не принято: архив полон неотправленными
+};
+
+/**
+ * @brief Архив записей в LittleFS в виде журнала сегментов.
+ *
+ * Сегмент — файл <dir>/XXXXXXXX.seg из SEGMENT_RECORDS слотов (номер записи,
+ * тело, CRC32); закрытый сегмент сжимается в .csg блоками по TIME_BLOCK
+ * записей (ArchiveCodec). Глобальный индекс = сегмент * SEGMENT_RECORDS + слот,
+ * монотонно растёт. Тело записи не меняется: действующий статус — в журнале
+ * подтверждений сегмента (ArchiveStatusLog). При открытии рваный хвост
+ * головного сегмента находится двоичным поиском и отбрасывается.
+ *
+ * Рядом с сегментами: индекс времени (<dir>/tindex), индекс коров (.cix),
+ * суточные итоги (RollupStore), курсоры потребителей (ArchiveConsumers) и
+ * пары «копия → оригинал» после уплотнения (<dir>/reloc). Хвост архива
+ * кэшируется в PSRAM (ARCHIVE_TAIL_CACHE).
+ *
+ * Групповой коммит копит записи и смены статуса в RAM и сбрасывает их
+ * одним проходом. Публичные методы выполняются под рекурсивным мьютексом
+ * (колбэки обходов — тоже); enqueue()/drain() — очередь приёма без блокировок.
+ */
 class ArchiveManager {
 public:
-    static const uint16_t EEPROM_SIZE = 4096;
-    static const uint8_t  RECORD_SIZE = sizeof(ArchiveRecord); // 13
-    static const uint16_t MAX_RECORDS = EEPROM_SIZE / RECORD_SIZE;
+    static const uint16_t SEGMENT_RECORDS = ARCHIVE_SEGMENT_RECORDS;
+    static const uint16_t MAX_SEGMENTS    = ARCHIVE_MAX_SEGMENTS;
+    static const uint32_t MAX_RECORDS     = (uint32_t)SEGMENT_RECORDS * MAX_SEGMENTS;
+    static const uint8_t  RECORD_SIZE     = sizeof(ArchiveRecord); // 24 (с выравниванием)
+    static const uint8_t  SLOT_SIZE       = RECORD_SIZE + 8;       ///< Запись в .seg: seq + тело + CRC
+    static const uint16_t SCAN_CHUNK      = ARCHIVE_SCAN_CHUNK;    ///< Слотов за одно чтение в _scan()
+    static const uint32_t SEGMENT_MAGIC   = 0x47534D41; // "AMSG"
+    static const uint32_t PACKED_MAGIC    = 0x43534D41; // "AMSC"
+    static const uint16_t FORMAT_VERSION  = 2;   ///< 1 — .seg без номера и CRC в слоте
+    static const size_t   EXPORT_JSON_MAX = 128; ///< Максимальная длина одной записи в exportJson()
+    static const uint32_t EXPORT_MAGIC        = 0x58424D41; // "AMBX"
+    static const uint16_t EXPORT_VERSION      = 1;
+    static const size_t   EXPORT_HEADER_SIZE  = 16;
+    static const size_t   EXPORT_RECORD_SIZE  = 25;   ///< Индекс + тело записи без выравнивания
+    static const size_t   EXPORT_TRAILER_SIZE = 10;
+    static const size_t   EXPORT_BLOCK_MIN    = 2 + EXPORT_RECORD_SIZE + 4;
+
+    ArchiveManager();
+    ~ArchiveManager();
+
+    /**
+     * @brief Поставить запись в очередь приёма (без блокировок и флеша).
+     * Вызывать только из одной задачи-производителя.
+     * @return false, если очередь полна (запись не принята)
+     */
+    bool enqueue(const ArchiveRecord& record);
+
+    /**
+     * @brief Перенести записи из очереди приёма в архив.
+     * Вызывать только из одной задачи-писателя. Запись, которую архив не
+     * принял (нет места), остаётся в очереди до следующего вызова: очередь
+     * заполняется, и enqueue() начинает отказывать — запись не теряется.
+     * @param max не больше стольких записей за вызов
+     * @param skip true — запись отбросить (например, повтор), до add()
+     * @param added вызывается для каждой записи, принятой архивом
+     * @return сколько записей забрано из очереди
+     */
+    uint16_t drain(uint16_t max = ARCHIVE_INGEST_QUEUE,
+                   std::function<bool(const ArchiveRecord&)> skip = nullptr,
+                   std::function<void(const ArchiveRecord&)> added = nullptr);
+
+    /// Записей в очереди приёма, ещё не перенесённых в архив
+    uint32_t ingestBacklog() const { return _ingest.size(); }
+    /// Записей, не принятых из-за переполнения очереди
+    uint32_t ingestDropped() const { return _ingestDropped; }
+
     /**
      * @brief Получить весь архив в виде JSON-массива.
+     *
+     * Собирает весь архив в одну строку в куче — только для небольших
+     * архивов. Для HTTP используйте потоковую выгрузку через exportJson().
      * @return Строка вида [{"client_id":..., "cow_id":..., "timestamp":..., "volume":..., "ec":..., "status":...}, ...]
      */
     String getArchiveJson();
-    void begin();
 
     /**
-     * @brief Добавить новую запись в архив (циклически).
+     * @brief Очередная порция JSON-экспорта: целые объекты записей с cursor,
+     * сколько поместится в buf (скобки массива выводит вызывающий).
+     * @param cursor глобальный индекс, с которого продолжать (в начале — firstIndex())
+     * @param buf    буфер вывода (не меньше EXPORT_JSON_MAX байт)
+     * @param size   размер буфера
+     * @param first  true до первой выведенной записи (перед ней не ставится запятая)
+     * @param filter какие записи выводить (по умолчанию все)
+     * @return число записанных байт; экспорт окончен, когда cursor >= endIndex()
+     */
+    size_t exportJson(uint32_t& cursor, char* buf, size_t size, bool& first,
+                      const ArchiveFilter& filter = ArchiveFilter());
+
+    /**
+     * @brief Двоичная выгрузка: заголовок потока.
+     *
+     * Формат (все поля little-endian, без выравнивания):
+     *  - заголовок, EXPORT_HEADER_SIZE байт: magic "AMBX" (u32), версия (u16),
+     *    размер записи EXPORT_RECORD_SIZE (u16), start — индекс, с которого
+     *    начат обход (u32), end — endIndex() на момент начала (u32);
+     *  - блоки: число записей n > 0 (u16), n записей по EXPORT_RECORD_SIZE байт
+     *    {index u32, client_id u32, cow_id u32, timestamp u32, volume f32,
+     *    ec f32, status u8}, CRC32 (IEEE) от n и записей (u32);
+     *  - завершение: 0 (u16), next — индекс для продолжения (u32), CRC32 от
+     *    этих 6 байт (u32).
+     * Оборванную выгрузку продолжают после последнего целого блока.
+     * @return число записанных байт (EXPORT_HEADER_SIZE)
+     */
+    static size_t exportBinaryHeader(uint8_t* buf, uint32_t start, uint32_t end);
+
+    /**
+     * @brief Очередной блок двоичной выгрузки (см. exportBinaryHeader()):
+     * записи с cursor, сколько поместится в buf.
+     * @param size размер буфера (не меньше EXPORT_BLOCK_MIN)
+     * @return число записанных байт; 0 и cursor >= endIndex() — записи кончились
+     */
+    size_t exportBinary(uint32_t& cursor, uint8_t* buf, size_t size,
+                        const ArchiveFilter& filter = ArchiveFilter());
+
+    /// Завершающий блок двоичной выгрузки. @return EXPORT_TRAILER_SIZE
+    static size_t exportBinaryTrailer(uint8_t* buf, uint32_t next);
+
+    /**
+     * @brief Записать одну запись как JSON-объект.
+     * @return длина как у snprintf (>= size — не поместилась)
+     */
+    static int recordJson(const ArchiveRecord& rec, char* buf, size_t size);
+
+    /**
+     * @brief Обойти записи с timestamp в диапазоне [from, to] по возрастанию индекса.
+     *
+     * Сегменты и блоки, не пересекающиеся с диапазоном по индексу времени,
+     * с флеша не читаются.
+     * @param fn колбэк (индекс, запись); вернуть false, чтобы остановить обход
+     */
+    void query(uint32_t from, uint32_t to, std::function<bool(uint32_t, const ArchiveRecord&)> fn);
+
+    /**
+     * @brief Обойти записи, подходящие под фильтр, по возрастанию индекса.
+     *
+     * Запись не копируется: ссылка действительна только внутри колбэка и до
+     * другого чтения архива из него. При cow_id обход идёт по индексу коров.
+     * @param fn     колбэк (индекс, запись); вернуть false, чтобы остановить обход
+     * @param cursor с какого индекса начинать (меньше firstIndex() — с начала)
      */
-    void add(const ArchiveRecord& record);
+    void visit(const ArchiveFilter& filter, std::function<bool(uint32_t, const ArchiveRecord&)> fn,
+               uint32_t cursor = 0);
+
+    /**
+     * @brief История коровы по возрастанию индекса (через индекс по cow_id).
+     * @param fn колбэк (индекс, запись); вернуть false, чтобы остановить обход
+     */
+    void cowHistory(uint32_t cowId, std::function<bool(uint32_t, const ArchiveRecord&)> fn);
+
+    /**
+     * @brief Последние доения коровы, от новых к старым.
+     * @param out массив на max записей
+     * @return сколько записей найдено
+     */
+    size_t lastMilkings(uint32_t cowId, ArchiveRecord* out, size_t max);
+
+    /**
+     * @brief Открыть архив: найти существующие сегменты и голову записи.
+     * @param fs  файловая система (LittleFS уже смонтирована в setup())
+     * @param dir каталог архива
+     * @return true, если каталог доступен
+     */
+    bool begin(fs::FS& fs = LittleFS, const char* dir = "/archive");
+
+    /**
+     * @brief Добавить новую запись в конец архива.
+     * @return false, если архив заполнен неотправленными записями или ошибка записи
+     */
+    bool add(const ArchiveRecord& record);
 
      /**
      * @brief Найти первую запись со статусом pending и вернуть её индекс.
+     *
+     * Берёт запись прямо под курсором неотправленных записей — без перебора
+     * архива. Курсор сдвигается в updateStatus() при подтверждении.
      * @param outIndex индекс найденной записи
      * @param outRec   сама запись
      * @return true, если такая запись есть
      */
-    bool getNextPending(uint16_t &outIndex, ArchiveRecord &outRec);
-    
+    bool getNextPending(uint32_t &outIndex, ArchiveRecord &outRec);
+
     /**
      * @brief Обновить статус записи по индексу.
-     * @param index индекс записи (0..MAX_RECORDS-1)
+     * @param index глобальный индекс записи (firstIndex()..endIndex()-1)
      * @param status новый статус (например, 1 = sent)
      */
-    void updateStatus(uint16_t index, uint8_t status);
+    void updateStatus(uint32_t index, uint8_t status);
+
+    /**
+     * @brief Прочитать запись по глобальному индексу.
+     * @return false, если записи с таким индексом нет (удалена, ещё не записана
+     *         или перенесена уплотнением — тогда её представляет копия)
+     */
+    bool readRecord(uint32_t index, ArchiveRecord& record);
 
     /**
      * @brief Экспорт всех записей (например, для JSON или MQTT).
      */
     void dumpAll(Stream& out);
 
+    /**
+     * @brief Включить групповой коммит.
+     * @param maxRecords сбрасывать, когда накопилось столько изменений
+     *                   (1 — писать сразу, как без группового коммита)
+     * @param maxDelayMs сбрасывать не позже, чем через столько мс
+     */
+    void setGroupCommit(uint16_t maxRecords, uint32_t maxDelayMs);
+
+    /**
+     * @brief Сбросить буферизованные записи и статусы на флеш.
+     * @return false при ошибке записи (данные остаются в буфере)
+     */
+    bool flush();
+
+    /**
+     * @brief Вызывать периодически: сбрасывает буфер по истечении maxDelayMs.
+     */
+    void poll();
+
+    ArchiveFlushStats flushStats() const;
+
+    /**
+     * @brief Один шаг уплотнения (вызывать в простое приёма).
+     *
+     * Самый старый сегмент без pending-записей удаляется; если pending в нём
+     * не больше ARCHIVE_COMPACT_MAX_LIVE, до ARCHIVE_COMPACT_BATCH из них
+     * переносятся в голову архива, а оригиналы исключаются из счётчиков и выгрузок.
+     * @return true, если шаг что-то сделал
+     */
+    bool compactStep();
+
+    ArchiveCompactStats compactStats() const;
+
+    /**
+     * @brief Задать политику хранения.
+     * Лишнее после уменьшения пределов удаляет compactStep(), по сегменту за шаг.
+     */
+    void setRetention(const ArchiveRetention& policy);
+    ArchiveRetention retention() const;
+    ArchiveRetentionStats retentionStats() const;
+
+    /// Попадания в кэш хвоста при чтении записей
+    ArchiveCacheStats cacheStats() const;
+
+    /// Индекс самой старой записи, хранящейся на флеше
+    uint32_t firstIndex() const;
+    /// Индекс, который получит следующая добавленная запись
+    uint32_t endIndex() const;
+    /// Курсор неотправленных записей: все записи с меньшим индексом уже не pending
+    uint32_t pendingHead() const;
+
+    /**
+     * @brief Инкрементальная синхронизация: записи, которых у получателя ещё нет.
+     *
+     * Выдаются только сброшенные на флеш записи. Копия после уплотнения
+     * несёт номер оригинала, каждая запись приходит один раз.
+     * @param seq    первый номер, которого у получателя нет (0 — всё с начала);
+     *               на выходе — откуда продолжать
+     * @param out    массив на max записей
+     * @param outSeq номера выданных записей (может быть nullptr)
+     * @return сколько записей выдано; 0 — получатель догнал архив
+     */
+    size_t readSince(uint64_t& seq, ArchiveRecord* out, uint64_t* outSeq, size_t max);
+
+    /// Номер записи для синхронизации (у копии после уплотнения — номер оригинала)
+    uint64_t seqOf(uint32_t index) const;
+
+    /// Случайный идентификатор архива: новый, когда архив создаётся заново
+    uint32_t archiveId() const { return _archiveId; }
+
+    /// Счётчики pending/sent/error/total (ведутся в RAM, без чтения флеша)
+    ArchiveCounters counters() const;
+    uint32_t pendingCount() const { return counters().pending; }
+
+    static const uint8_t MAX_CONSUMERS     = ArchiveConsumers::CAPACITY;
+    static const uint8_t CONSUMER_NAME_MAX = ArchiveConsumers::NAME_LEN;
+
+    /**
+     * @brief Найти потребителя по имени или завести нового (курсор — в начале архива).
+     * @param name до CONSUMER_NAME_MAX символов: латиница, цифры, '_' и '-'
+     * @return номер потребителя или -1, если имя недопустимо или все MAX_CONSUMERS заняты
+     */
+    int8_t openConsumer(const char* name);
+
+    /// Номер потребителя по имени или -1
+    int8_t findConsumer(const char* name) const;
+
+    /**
+     * @brief Удалить потребителя и освободить его место.
+     * Номера следующих за ним потребителей сдвигаются — держать номер
+     * между вызовами нельзя, ищите по имени.
+     * @return false, если такого потребителя нет
+     */
+    bool closeConsumer(const char* name);
+
+    /**
+     * @brief Первая недоставленная потребителю запись.
+     * @param outIndex номер записи, как в readSince(): у копии уплотнения —
+     *        номер оригинала; подтверждать consumerAck(id, outIndex + 1)
+     * @return false, если потребитель дошёл до конца архива
+     */
+    bool consumerNext(uint8_t id, uint32_t& outIndex, ArchiveRecord& outRec);
+
+    /**
+     * @brief Подтвердить доставку потребителю всех записей с индексом < end.
+     * Курсор только растёт; на флеш он уходит со следующим сбросом.
+     */
+    void consumerAck(uint8_t id, uint32_t end);
+
+    /// Позиция потребителя: индекс первой недоставленной записи
+    uint32_t consumerCursor(uint8_t id) const;
+    /// Отставание потребителя, записей
+    uint32_t consumerLag(uint8_t id) const;
+    const char* consumerName(uint8_t id) const;
+    uint8_t consumerCount() const;
+
+    /**
+     * @brief Суточные итоги коровы за [fromDay, toDay] (см. RollupStore::range()).
+     * Колбэк вызывается под мьютексом архива.
+     */
+    RollupRow rollupRange(uint32_t cowId, uint32_t fromDay, uint32_t toDay,
+                          std::function<bool(uint32_t, const RollupRow&)> fn = nullptr);
+
 private:
-    uint16_t write_index = 0;
+    struct SegmentHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t record_size;
+        uint32_t segment;
+    };
+
+    /// Слот несжатого сегмента
+    struct RecordSlot {
+        uint32_t      seq;      ///< Глобальный индекс записи
+        ArchiveRecord record;
+        uint32_t      crc;      ///< CRC32 от seq и record
+    };
+    static_assert(sizeof(RecordSlot) == SLOT_SIZE, "слот без выравнивания");
+
+    /// Оригинал, перенесённый уплотнением: не входит в счётчики и выгрузки
+    static const uint8_t STATUS_MOVED = ArchiveStatusLog::MOVED;
+
+    /// Захват рекурсивного мьютекса архива на время области видимости
+    struct Lock {
+        SemaphoreHandle_t m;
+        explicit Lock(SemaphoreHandle_t mutex) : m(mutex) { xSemaphoreTakeRecursive(m, portMAX_DELAY); }
+        ~Lock() { xSemaphoreGiveRecursive(m); }
+    };
+    SemaphoreHandle_t _mutex = nullptr;
+    SpscQueue<ArchiveRecord, ARCHIVE_INGEST_QUEUE> _ingest;
+    uint32_t _ingestDropped = 0;
+    bool     _ingestRetry   = false;   ///< Голова очереди приёма уже получала отказ
+
+    fs::FS*  _fs        = nullptr;
+    String   _dir;
+    uint32_t _firstSeg  = 0;  ///< Самый старый сегмент на флеше
+    uint32_t _headSeg   = 0;  ///< Сегмент, в который идёт дозапись
+    uint16_t _headCount = 0;  ///< Число записей в головном сегменте (на флеше)
+    File     _headFile;       ///< Головной сегмент, открыт на чтение/запись
+    File     _readFile;       ///< Кэш последнего прочитанного закрытого сегмента
+    uint32_t _readSeg   = UINT32_MAX;
+    uint32_t _pendingHead = 0; ///< Первая запись, которая может быть pending
+    ArchiveCounters _counters = {0, 0, 0, 0};
+
+    // Групповой коммит: новые записи ещё не на флеше (всегда в головном
+    // сегменте, сразу за _headCount) и отложенные смены статуса
+    typedef ArchiveStatusLog::Change StatusChange;
+    ArchiveRecord _batch[ARCHIVE_GROUP_COMMIT_MAX];
+    StatusChange  _acks[ARCHIVE_GROUP_COMMIT_MAX];
+    uint16_t _batchCount   = 0;
+    uint16_t _ackCount     = 0;
+    uint16_t _groupMax     = 1;
+    uint32_t _groupDelayMs = 0;
+    uint32_t _dirtySince   = 0;
+    bool     _stateDirty   = false;
+    ArchiveFlushStats _flushStats = {0, 0, 0, 0, 0};
+    ArchiveCompactStats _compactStats = {0, 0, 0, 0, 0};
+    ArchiveRetention      _retention;
+    ArchiveRetentionStats _retentionStats = {0, 0, 0, 0};
+    bool     _full         = false;   ///< Последний _append() отказал по политике хранения
+
+    ArchiveConsumers _consumers;
+
+    /// Копия, перенесённая уплотнением (запись файла <dir>/reloc)
+    struct Relocation {
+        uint32_t index;    ///< Индекс копии
+        uint32_t origin;   ///< Индекс оригинала — номер записи
+    };
+    static const uint32_t RELOC_MAGIC = 0x4C524D41; // "AMRL"
+    static const uint16_t RELOC_MAX   = ARCHIVE_RELOC_MAX;
+    Relocation _reloc[RELOC_MAX];   ///< По возрастанию index
+    uint16_t _relocCount = 0;
+    bool     _relocDirty = false;
+    uint32_t _archiveId  = 0;
+
+    // Кэш хвоста: записи [_tailStart, endIndex()) в кольце, слот — index % ёмкость
+    ArchiveRecord*    _tail      = nullptr;
+    uint32_t          _tailStart = 0;
+    ArchiveCacheStats _cacheStats = {0, 0, 0};
+
+    RollupStore _rollup;
+
+    ArchiveStatusLog _statusLog;
+
+    // Индекс времени. Пустой диапазон: min > max
+    static const uint16_t TIME_BLOCK  = ARCHIVE_TIME_BLOCK;
+    static const uint16_t TIME_BLOCKS = (SEGMENT_RECORDS + TIME_BLOCK - 1) / TIME_BLOCK;
+    struct TimeRange {
+        uint32_t min;
+        uint32_t max;
+        bool overlaps(uint32_t from, uint32_t to) const { return min <= to && max >= from; }
+        void extend(uint32_t ts) {
+            if (ts < min) min = ts;
+            if (ts > max) max = ts;
+        }
+    };
+    /// Запись файла <dir>/tindex; слот — seg % MAX_SEGMENTS
+    struct TimeIndexEntry {
+        uint32_t  seg;
+        TimeRange range;
+        TimeRange blocks[TIME_BLOCKS];
+    };
+    /// Заголовок сжатого сегмента (<dir>/XXXXXXXX.csg)
+    struct PackedHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t count;                   ///< Записей в сегменте
+        uint32_t segment;
+        uint32_t offsets[TIME_BLOCKS];    ///< Смещения блоков от начала файла
+    };
+    bool          _readPacked = false;    ///< _readFile — сжатый сегмент
+    PackedHeader  _packHdr;               ///< Заголовок открытого сжатого сегмента
+    ArchiveRecord _blockCache[TIME_BLOCK];///< Последний распакованный блок (статусы наложены)
+    uint32_t      _blockSeg   = UINT32_MAX;
+    uint16_t      _blockNo    = 0;
+    uint16_t      _blockLen   = 0;
 
-    void writeRecord(uint16_t index, const ArchiveRecord& record);
-    bool readRecord(uint16_t index, ArchiveRecord& record);
+    TimeRange _segTime[MAX_SEGMENTS];  ///< Диапазоны сегментов, по seg % MAX_SEGMENTS
+    TimeRange _headTime[TIME_BLOCKS];  ///< Блоки головного сегмента (вместе с буфером)
+
+    /// Запись индекса по коровам (<dir>/XXXXXXXX.cix), сортировка по (cow_id, slot)
+    struct CowIndexEntry {
+        uint32_t cow_id;
+        uint16_t slot;
+        uint16_t reserved;
+    };
+    uint32_t _headCows[SEGMENT_RECORDS];  ///< cow_id по слотам головного сегмента
+    static const uint32_t NO_COW = UINT32_MAX; ///< Слот _headCows без записи (битый)
+
+    /// Сохраняемое состояние архива (файл <dir>/state)
+    struct StateFile {
+        uint32_t magic;
+        uint32_t pending_head;
+        uint32_t counted_end;     ///< Счётчики учитывают записи до этого индекса
+        ArchiveCounters counters;
+        uint32_t archive_id;
+    };
+    static const uint32_t STATE_MAGIC = 0x54534D41; // "AMST"
+
+    String _segmentPath(uint32_t seg, const char* ext = ".seg") const;
+    /// Действующий статус записи на флеше (журнал + тело) с учётом буфера
+    bool   _storedStatus(uint32_t index, uint8_t& status);
+    /// Загрузить индексы времени и коров, достроив недостающее сканированием
+    void   _loadIndexes();
+    /// Открыть суточные итоги и досчитать записи, которых в них ещё нет
+    void   _loadRollups();
+    bool   _readTimeEntry(uint32_t seg, TimeIndexEntry& entry);
+    bool   _saveTimeEntry(const TimeIndexEntry& entry);
+    /// Обнулить диапазоны блоков и сегмента (новый головной сегмент)
+    void   _resetHeadTime();
+    /**
+     * @brief Обход записей из [from, to] начиная с индекса cursor,
+     * с пропуском сегментов и блоков по индексу времени.
+     */
+    void   _query(uint32_t cursor, uint32_t from, uint32_t to,
+                  std::function<bool(uint32_t, const ArchiveRecord&)> fn);
+    /// Записать .cix сегмента из пар (cow_id, slot); e сортируется на месте
+    bool   _writeCowIndex(uint32_t seg, CowIndexEntry* e, uint16_t count);
+    /// Записать .cix закрываемого головного сегмента по _headCows
+    bool   _sealCowIndex();
+    /// Построить .cix сегмента по его записям (старый архив или сбой)
+    bool   _buildCowIndex(uint32_t seg);
+    /**
+     * @brief Индексы записей коровы в сегменте seg, не меньше from (или, при
+     * reverse, меньше from — от новых к старым). fn возвращает false для остановки.
+     * @return false, если обход остановлен колбэком
+     */
+    bool   _cowSegment(uint32_t seg, uint32_t cowId, uint32_t from, bool reverse,
+                       std::function<bool(uint32_t)> fn);
+    /// История коровы начиная с индекса cursor
+    void   _cowHistory(uint32_t cursor, uint32_t cowId,
+                       std::function<bool(uint32_t, const ArchiveRecord&)> fn);
+    /// Сжать закрытый сегмент .seg в .csg (через временный файл)
+    bool   _packSegment(uint32_t seg);
+    /// Распаковать блок сжатого сегмента в _blockCache
+    bool   _loadBlock(uint32_t seg, uint16_t block);
+    /**
+     * @brief Запись по индексу с действующим статусом — без копирования, если
+     * она в RAM (кэш хвоста, буфер, распакованный блок), иначе в scratch.
+     * @return nullptr, если записи нет; указатель действителен до следующего чтения
+     */
+    const ArchiveRecord* _recordAt(uint32_t index, ArchiveRecord& scratch);
+    /// Обход по фильтру начиная с cursor (без мьютекса)
+    void   _visit(uint32_t cursor, const ArchiveFilter& filter,
+                  std::function<bool(uint32_t, const ArchiveRecord&)> fn);
+    /// Запись по индексу, включая перенесённые оригиналы (для выдачи по номерам)
+    bool   _readAny(uint32_t index, ArchiveRecord& record);
+    /// readSince() без мьютекса, до индекса end
+    size_t _readSince(uint64_t& seq, ArchiveRecord* out, uint64_t* outSeq, size_t max, uint32_t end);
+    /// updateStatus() без мьютекса; принимает и STATUS_MOVED
+    void   _setStatus(uint32_t index, uint8_t status);
+    /// Прочитать запись слота как есть на флеше (без журнала статусов)
+    bool   _readSlot(uint32_t seg, uint16_t slot, ArchiveRecord& record);
+    bool   _openHead(uint32_t seg, bool create);
+    /// Целый ли слот: CRC сходится и номер совпадает с позицией
+    static bool _slotValid(const RecordSlot& s, uint32_t index);
+    static uint32_t _slotCrc(const RecordSlot& s);
+    /**
+     * @brief Восстановление головного сегмента после сбоя: двоичный поиск
+     * первого нецелого слота среди n записанных, хвост за ним затирается.
+     * @return число целых записей
+     */
+    uint16_t _recoverHead(uint16_t n);
+    /// Переписать .seg формата 1 в слоты с номером и CRC (через временный файл)
+    bool   _upgradeSegment(uint32_t seg);
+    bool   _sealHead();
+    /**
+     * @brief Удалить самый старый сегмент.
+     * @param force удалить и с pending-записями (они учитываются в overflow)
+     */
+    bool   _dropOldestSegment(bool force = false);
+    /// Предел числа сегментов по политике хранения (2..MAX_SEGMENTS)
+    uint32_t _segmentLimit() const;
+    /// Все записи сегмента старше maxAgeDays от самой новой записи архива
+    bool   _segmentExpired(uint32_t seg) const;
+    /// Выделить кэш хвоста (PSRAM) и заполнить его с флеша
+    void   _loadTail();
+    bool   _tailCached(uint32_t index) const {
+        return _cacheStats.capacity && index >= _tailStart && index < _endIndex();
+    }
+    ArchiveRecord& _tailAt(uint32_t index) { return _tail[index % _cacheStats.capacity]; }
+    /// Байт на флеше, занятых сегментом (данные, журнал, индекс коров)
+    size_t _segmentBytes(uint32_t seg);
+    /// Добавить запись; rollup = false — не учитывать в итогах (перенос)
+    bool   _append(const ArchiveRecord& record, bool rollup);
+    /// add() без мьютекса; countReject — учесть отказ по переполнению в rejected
+    bool   _add(const ArchiveRecord& record, bool countReject);
+    File*  _segmentFile(uint32_t seg);
+    void   _loadState();
+    void   _saveState();
+    void   _loadRelocations();
+    bool   _saveRelocations();
+    /// Индекс оригинала для копии после уплотнения, иначе сам index
+    uint32_t _origin(uint32_t index) const;
+    /// Сдвинуть курсор через уже отправленные/ошибочные записи
+    void   _advancePendingHead();
+    /// Учесть запись со статусом status в счётчиках (delta = +1 / -1)
+    void   _countStatus(uint8_t status, int32_t delta);
+    uint32_t _flushedEnd() const { return _headSeg * SEGMENT_RECORDS + _headCount; }
+    /// Без мьютекса — для кода, который его уже держит (публичные версии его берут)
+    uint32_t _firstIndex() const { return _firstSeg * SEGMENT_RECORDS; }
+    uint32_t _endIndex() const { return _flushedEnd() + _batchCount; }
+    bool   _isDirty() const { return _batchCount || _ackCount || _stateDirty || _consumers.dirty() || _relocDirty; }
+    void   _markDirty();
+    /// Наложить журнал и отложенные смены статуса на прочитанную с флеша запись
+    void   _overlayStatus(uint32_t index, ArchiveRecord& record, const ArchiveStatusLog::Map* map) const;
+    StatusChange* _findAck(uint32_t index);
+    size_t _slotOffset(uint16_t slot) const {
+        return sizeof(SegmentHeader) + (size_t)slot * SLOT_SIZE;
+    }
+    /**
+     * @brief Последовательный обход записей начиная с индекса from.
+     * Колбэк возвращает false, чтобы остановить обход.
+     */
+    void _scan(uint32_t from, std::function<bool(uint32_t, const ArchiveRecord&)> fn);
 };
 
 #endif
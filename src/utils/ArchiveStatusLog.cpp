@@ -0,0 +1,85 @@
+#include "ArchiveStatusLog.h"
+
+void ArchiveStatusLog::Map::set(uint16_t slot, uint8_t st) {
+    if (st == MOVED) {
+        moved[slot >> 3] |= 1 << (slot & 7);
+        return;
+    }
+    uint8_t sh = (slot & 3) * 2;
+    bits[slot >> 2] = (bits[slot >> 2] & ~(3 << sh)) | ((st & 3) << sh);
+}
+
+void ArchiveStatusLog::Map::clear() {
+    memset(bits, 0xFF, sizeof(bits));
+    memset(moved, 0, sizeof(moved));
+}
+
+void ArchiveStatusLog::begin(fs::FS& fs, const String& dir) {
+    _fs  = &fs;
+    _dir = dir;
+    for (uint8_t i = 0; i < ARCHIVE_STATUS_MAPS; i++) _maps[i].valid = false;
+}
+
+String ArchiveStatusLog::_path(uint32_t seg) const {
+    char name[16];
+    snprintf(name, sizeof(name), "/%08lX.ack", (unsigned long)seg);
+    return _dir + name;
+}
+
+const ArchiveStatusLog::Map* ArchiveStatusLog::map(uint32_t seg) {
+    Map* victim = &_maps[0];
+    for (uint8_t i = 0; i < ARCHIVE_STATUS_MAPS; i++) {
+        Map& m = _maps[i];
+        if (m.valid && m.seg == seg) {
+            m.lastUse = ++_clock;
+            return &m;
+        }
+        if (!m.valid || m.lastUse < victim->lastUse) victim = &m;
+    }
+
+    // Промах: строим карту заново, проигрывая журнал (последняя запись побеждает)
+    victim->seg     = seg;
+    victim->valid   = true;
+    victim->lastUse = ++_clock;
+    victim->clear();
+    File f = _fs->open(_path(seg), "r");
+    if (f) {
+        Entry buf[32];
+        size_t n;
+        while ((n = f.read((uint8_t*)buf, sizeof(buf))) >= sizeof(Entry)) {
+            for (size_t i = 0; i < n / sizeof(Entry); i++) {
+                if (buf[i].slot < SLOTS) victim->set(buf[i].slot, buf[i].status);
+            }
+        }
+        f.close();
+    }
+    return victim;
+}
+
+bool ArchiveStatusLog::append(uint32_t seg, const Change* changes, uint16_t count) {
+    File f = _fs->open(_path(seg), "a");
+    if (!f) return false;
+    Entry buf[ARCHIVE_GROUP_COMMIT_MAX];
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < count && n < ARCHIVE_GROUP_COMMIT_MAX; i++) {
+        if (changes[i].index / SLOTS != seg) continue;
+        buf[n++] = {(uint16_t)(changes[i].index % SLOTS), changes[i].status, 0};
+    }
+    size_t bytes = n * sizeof(Entry);
+    bool ok = f.write((const uint8_t*)buf, bytes) == bytes;
+    f.close();
+
+    // Держим закэшированную карту в согласии с журналом
+    for (uint8_t i = 0; ok && i < ARCHIVE_STATUS_MAPS; i++) {
+        if (!_maps[i].valid || _maps[i].seg != seg) continue;
+        for (uint16_t j = 0; j < n; j++) _maps[i].set(buf[j].slot, buf[j].status);
+    }
+    return ok;
+}
+
+void ArchiveStatusLog::remove(uint32_t seg) {
+    _fs->remove(_path(seg));
+    for (uint8_t i = 0; i < ARCHIVE_STATUS_MAPS; i++) {
+        if (_maps[i].seg == seg) _maps[i].valid = false;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef ARCHIVE_STATUS_LOG_H
+#define ARCHIVE_STATUS_LOG_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "ArchiveConfig.h"
+
+/**
+ * @brief Журналы подтверждений сегментов архива (<dir>/XXXXXXXX.ack).
+ *
+ * Смена статуса дописывается в журнал своего сегмента 4-байтной записью
+ * (слот, статус); последняя запись слота побеждает. Для чтения журнал
+ * проигрывается в карту статусов сегмента, ARCHIVE_STATUS_MAPS последних
+ * карт держатся в RAM. Мьютекса нет — вызывает ArchiveManager под своим.
+ */
+class ArchiveStatusLog {
+public:
+    static const uint16_t SLOTS = ARCHIVE_SEGMENT_RECORDS;
+    static const uint8_t  NONE  = 0xFF;   ///< В журнале нет — статус из тела записи
+    static const uint8_t  MOVED = 0xFE;   ///< Запись перенесена уплотнением, её представляет копия
+
+    /// Смена статуса записи с глобальным индексом index
+    struct Change {
+        uint32_t index;
+        uint8_t  status;
+    };
+
+    /// Статусы одного сегмента: 2 бита на слот (3 — нет в журнале) и бит переноса
+    struct Map {
+        uint32_t seg;
+        uint32_t lastUse;
+        bool     valid;
+        uint8_t  bits[(SLOTS + 3) / 4];
+        uint8_t  moved[(SLOTS + 7) / 8];
+
+        /// Статус слота, MOVED или NONE
+        uint8_t get(uint16_t slot) const {
+            if (moved[slot >> 3] & (1 << (slot & 7))) return MOVED;
+            uint8_t st = (bits[slot >> 2] >> ((slot & 3) * 2)) & 3;
+            return st == 3 ? NONE : st;
+        }
+        void set(uint16_t slot, uint8_t st);
+        void clear();
+    };
+
+    /// Каталог журналов; карты в RAM сбрасываются
+    void begin(fs::FS& fs, const String& dir);
+
+    /**
+     * @brief Карта статусов сегмента (при промахе кэша читается журнал).
+     * Указатель действителен до следующего вызова map().
+     */
+    const Map* map(uint32_t seg);
+
+    /// Дописать в журнал сегмента seg те из changes, что к нему относятся
+    bool append(uint32_t seg, const Change* changes, uint16_t count);
+
+    /// Удалить журнал сегмента и забыть его карту
+    void remove(uint32_t seg);
+
+private:
+    /// Запись журнала на флеше
+    struct Entry {
+        uint16_t slot;
+        uint8_t  status;
+        uint8_t  reserved;
+    };
+
+    fs::FS*  _fs = nullptr;
+    String   _dir;
+    Map      _maps[ARCHIVE_STATUS_MAPS] = {};
+    uint32_t _clock = 0;
+
+    String _path(uint32_t seg) const;
+};
+
+#endif
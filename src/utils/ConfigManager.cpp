@@ -26,11 +26,43 @@ String ConfigManager::getClientID()  {
     return _getString(KEY_RS485_ID, "");
 }
 
+// Возвращает Client ID как адрес шины RS485 или 0
+uint8_t ConfigManager::getRS485Addr()  {
+    return parseRS485Addr(getClientID());
+}
+
+// Только цифры и 1…255: toInt() даёт 0 и для "", и для "A1"
+uint8_t ConfigManager::parseRS485Addr(const String& s) {
+    String t = s;
+    t.trim();
+    if (t.length() == 0 || t.length() > 3) return 0;
+    for (size_t i = 0; i < t.length(); i++) {
+        if (!isdigit((unsigned char)t[i])) return 0;
+    }
+    long addr = t.toInt();
+    return (addr > 0 && addr <= 255) ? (uint8_t)addr : 0;
+}
+
 // Возвращает скорость RS485
 uint32_t ConfigManager::getRS485Baud()  {
     return _getUInt32(KEY_RS485_BAUD, 9600);
 }
 
+// Возвращает адреса опрашиваемых ПУМ из строки "1,2,5"
+size_t ConfigManager::getRS485Clients(uint8_t* out, size_t max)  {
+    String list = _getString(KEY_RS485_POLL, "");
+    size_t n = 0;
+    int from = 0;
+    while (n < max && from < (int)list.length()) {
+        int comma = list.indexOf(',', from);
+        if (comma < 0) comma = list.length();
+        uint8_t addr = parseRS485Addr(list.substring(from, comma));
+        if (addr) out[n++] = addr;
+        from = comma + 1;
+    }
+    return n;
+}
+
 // Возвращает MQTT сервер
 String ConfigManager::getMQTTServer()  {
     return _getString(KEY_MQTT_SERVER, "");
@@ -56,21 +88,42 @@ String ConfigManager::getRESTURL()  {
     return _getString(KEY_REST_URL, "");
 }
 
+// Возвращает максимальный возраст записей архива (сутки)
+uint32_t ConfigManager::getArchiveMaxAgeDays()  {
+    return _getUInt32(KEY_ARC_AGE, 0);
+}
+
+// Возвращает предел размера архива (записи)
+uint32_t ConfigManager::getArchiveMaxRecords()  {
+    return _getUInt32(KEY_ARC_MAX, 0);
+}
+
+// Можно ли вытеснять неотправленные записи при переполнении
+bool ConfigManager::getArchiveDropPending()  {
+    return _getUInt32(KEY_ARC_DROP, 0) != 0;
+}
+
 // Формирует JSON с текущими настройками
 String ConfigManager::getConfigJSON()  {
     // Оценим размер документа: 
-    // SSID (~32), password (~64), rs485_id (~10), mqtt strings (~64), rest_url (~128)
-    DynamicJsonDocument doc(512);
+    // SSID (~32), password (~64), rs485_id (~10), rs485_clients (~40),
+    // mqtt strings (~64), rest_url (~128),
+    // политика архива (~80)
+    DynamicJsonDocument doc(704);
 
     doc["ssid"] = _getString(KEY_SSID, "");
     doc["password"] = _getString(KEY_PASSWORD, "");
     doc["rs485_id"] = _getString(KEY_RS485_ID, "");
     doc["rs485_baud"] = static_cast<uint32_t>(_getUInt32(KEY_RS485_BAUD, 9600));
+    doc["rs485_clients"] = _getString(KEY_RS485_POLL, "");
     doc["mqtt_server"] = _getString(KEY_MQTT_SERVER, "");
     doc["mqtt_port"] = static_cast<uint32_t>(_getUInt32(KEY_MQTT_PORT, 1883));
     doc["mqtt_user"] = _getString(KEY_MQTT_USER, "");
     doc["mqtt_pass"] = _getString(KEY_MQTT_PASS, "");
     doc["rest_url"] = _getString(KEY_REST_URL, "");
+    doc["archive_max_age_days"] = getArchiveMaxAgeDays();
+    doc["archive_max_records"] = getArchiveMaxRecords();
+    doc["archive_drop_pending"] = getArchiveDropPending();
 
     String output;
     serializeJson(doc, output);
@@ -79,7 +132,7 @@ String ConfigManager::getConfigJSON()  {
 
 // Парсит JSON и сохраняет параметры в Preferences
 void ConfigManager::saveConfigFromJSON(const String& jsonStr) {
-    DynamicJsonDocument doc(512);
+    DynamicJsonDocument doc(704);
     DeserializationError err = deserializeJson(doc, jsonStr);
     if (err) {
         // Ошибка при парсинге JSON — ничего не сохраняем
@@ -96,12 +149,17 @@ void ConfigManager::saveConfigFromJSON(const String& jsonStr) {
     }
     if (doc.containsKey("rs485_id")) {
         String rsid = doc["rs485_id"].as<const char*>();
-        _saveString(KEY_RS485_ID, rsid);
+        // Client ID — адрес ПУМ на шине: не число 1…255 не сохраняем
+        if (parseRS485Addr(rsid)) _saveString(KEY_RS485_ID, rsid);
     }
     if (doc.containsKey("rs485_baud")) {
         uint32_t baud = doc["rs485_baud"].as<uint32_t>();
         _saveUInt32(KEY_RS485_BAUD, baud);
     }
+    if (doc.containsKey("rs485_clients")) {
+        String list = doc["rs485_clients"].as<const char*>();
+        _saveString(KEY_RS485_POLL, list);
+    }
     if (doc.containsKey("mqtt_server")) {
         String mserv = doc["mqtt_server"].as<const char*>();
         _saveString(KEY_MQTT_SERVER, mserv);
@@ -122,6 +180,15 @@ void ConfigManager::saveConfigFromJSON(const String& jsonStr) {
         String rur = doc["rest_url"].as<const char*>();
         _saveString(KEY_REST_URL, rur);
     }
+    if (doc.containsKey("archive_max_age_days")) {
+        _saveUInt32(KEY_ARC_AGE, doc["archive_max_age_days"].as<uint32_t>());
+    }
+    if (doc.containsKey("archive_max_records")) {
+        _saveUInt32(KEY_ARC_MAX, doc["archive_max_records"].as<uint32_t>());
+    }
+    if (doc.containsKey("archive_drop_pending")) {
+        _saveUInt32(KEY_ARC_DROP, doc["archive_drop_pending"].as<bool>() ? 1 : 0);
+    }
 }
 void ConfigManager::saveWiFiCredentials(const String& ssid, const String& password) {
     // Сохраняем SSID
@@ -172,6 +239,10 @@ void ConfigManager::saveRS485Baud(uint32_t baud) {
     _saveUInt32(KEY_RS485_BAUD, baud);
 }
 
+void ConfigManager::saveRS485Clients(const String& list) {
+    _saveString(KEY_RS485_POLL, list);
+}
+
 void ConfigManager::saveMQTTServer(const String& addr) {
     _saveString(KEY_MQTT_SERVER, addr);
 }
@@ -186,4 +257,9 @@ void ConfigManager::saveMQTTPass(const String& pass) {
 
 void ConfigManager::saveRESTURL(const String& url) {
     _saveString(KEY_REST_URL, url);
-}
\ No newline at end of file
+}
+void ConfigManager::saveArchiveRetention(uint32_t maxAgeDays, uint32_t maxRecords, bool dropPending) {
+    _saveUInt32(KEY_ARC_AGE, maxAgeDays);
+    _saveUInt32(KEY_ARC_MAX, maxRecords);
+    _saveUInt32(KEY_ARC_DROP, dropPending ? 1 : 0);
+}
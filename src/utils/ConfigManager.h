@@ -11,9 +11,11 @@
  * Хранит и читает следующие параметры:
  *  - SSID и пароль Wi-Fi
  *  - RS485 Client ID
+ *  - Адреса ПУМ, которые опрашивает сервер
  *  - Скорость RS485 (baud rate)
  *  - MQTT сервер, порт, логин, пароль
  *  - REST URL
+ *  - Политику хранения архива (возраст, размер, вытеснение pending)
  * 
  * Также умеет сериализовать/десериализовать настройки в/из JSON,
  * что удобно для веб-конфигурирования через Mongoose.
@@ -61,6 +63,21 @@ public:
      */
     String getClientID() ;
 
+    /**
+     * @brief Возвращает RS485 Client ID как адрес на шине.
+     *
+     * @return uint8_t — адрес 1…255; 0, если Client ID не число в этих
+     *         пределах (пустой, "A1", "300") — такой ПУМ сервер не опросит.
+     */
+    uint8_t getRS485Addr() ;
+
+    /**
+     * @brief Разбирает адрес шины RS485: десятичное число 1…255.
+     *
+     * @return uint8_t — адрес или 0, если строка не адрес.
+     */
+    static uint8_t parseRS485Addr(const String& s);
+
     /**
      * @brief Возвращает сохранённый baud rate для RS485.
      * 
@@ -68,6 +85,18 @@ public:
      */
     uint32_t getRS485Baud() ;
 
+    /**
+     * @brief Возвращает адреса ПУМ (их RS485 Client ID), опрашиваемые сервером.
+     *
+     * Хранятся строкой через запятую, например "1,2,5". Пустой список —
+     * сервер не опрашивает шину, а только слушает (клиенты передают сами).
+     *
+     * @param out Сюда записываются адреса 1…255.
+     * @param max Размер out.
+     * @return size_t — число адресов.
+     */
+    size_t getRS485Clients(uint8_t* out, size_t max) ;
+
     /**
      * @brief Возвращает адрес MQTT-брокера (IP или hostname).
      * 
@@ -103,6 +132,27 @@ public:
      */
     String getRESTURL() ;
 
+    /**
+     * @brief Возвращает максимальный возраст записей архива.
+     * 
+     * @return uint32_t — суток, 0 — без ограничения.
+     */
+    uint32_t getArchiveMaxAgeDays() ;
+
+    /**
+     * @brief Возвращает предел размера архива.
+     * 
+     * @return uint32_t — записей, 0 — весь раздел.
+     */
+    uint32_t getArchiveMaxRecords() ;
+
+    /**
+     * @brief Можно ли при переполнении архива вытеснять неотправленные записи.
+     * 
+     * @return true — вытеснять (с учётом потерь), false — не принимать новые.
+     */
+    bool getArchiveDropPending() ;
+
     /**
      * @brief Генерирует JSON-строку с текущими настройками.
      * 
@@ -112,11 +162,15 @@ public:
      *   "password": "...",
      *   "rs485_id": "...",
      *   "rs485_baud": 9600,
+     *   "rs485_clients": "1,2,5",
      *   "mqtt_server": "...",
      *   "mqtt_port": 1883,
      *   "mqtt_user": "...",
      *   "mqtt_pass": "...",
-     *   "rest_url": "..."
+     *   "rest_url": "...",
+     *   "archive_max_age_days": 0,
+     *   "archive_max_records": 0,
+     *   "archive_drop_pending": false
      * }
      * 
      * @return String — JSON с параметрами.
@@ -132,11 +186,15 @@ public:
      *   "password": "MyPass",
      *   "rs485_id": "A1",
      *   "rs485_baud": 9600,
+     *   "rs485_clients": "1,2,5",
      *   "mqtt_server": "broker.example.com",
      *   "mqtt_port": 1883,
      *   "mqtt_user": "user",
      *   "mqtt_pass": "pass",
-     *   "rest_url": "https://api.example.com"
+     *   "rest_url": "https://api.example.com",
+     *   "archive_max_age_days": 365,
+     *   "archive_max_records": 100000,
+     *   "archive_drop_pending": false
      * }
      * 
      * @param jsonStr JSON с обновлёнными параметрами.
@@ -147,10 +205,12 @@ public:
   void saveWiFiCredentials(const String& ssid, const String& password);   
   void saveRS485ID(const String& id);
 void saveRS485Baud(uint32_t baud);
+void saveRS485Clients(const String& list);
 void saveMQTTServer(const String& addr);
 void saveMQTTUser(const String& user);
 void saveMQTTPass(const String& pass);
 void saveRESTURL(const String& url);
+void saveArchiveRetention(uint32_t maxAgeDays, uint32_t maxRecords, bool dropPending);
     void commit();  
     // Публичные поля для прямого доступа (если нужно)
     String savedSSID;
@@ -170,11 +230,15 @@ private:
     static constexpr const char* KEY_PASSWORD    = "password";
     static constexpr const char* KEY_RS485_ID    = "rs485_id";
     static constexpr const char* KEY_RS485_BAUD  = "rs485_baud";
+    static constexpr const char* KEY_RS485_POLL  = "rs485_clients";
     static constexpr const char* KEY_MQTT_SERVER = "mqtt_srv";
     static constexpr const char* KEY_MQTT_PORT   = "mqtt_prt";
     static constexpr const char* KEY_MQTT_USER   = "mqtt_usr";
     static constexpr const char* KEY_MQTT_PASS   = "mqtt_pwd";
     static constexpr const char* KEY_REST_URL    = "rest_url";
+    static constexpr const char* KEY_ARC_AGE     = "arc_age";
+    static constexpr const char* KEY_ARC_MAX     = "arc_max";
+    static constexpr const char* KEY_ARC_DROP    = "arc_drop";
 };
 
 #endif // CONFIG_MANAGER_H
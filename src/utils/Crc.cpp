@@ -0,0 +1,56 @@
+#include "Crc.h"
+
+namespace {
+
+// Значение таблицы: CRC одного байта i при нулевом начальном значении
+constexpr uint8_t crc8Entry(uint8_t crc, int bits = 8) {
+    return bits == 0 ? crc
+                     : crc8Entry((crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1),
+                                 bits - 1);
+}
+
+constexpr uint16_t crc16Entry(uint16_t crc, int bits = 8) {
+    return bits == 0 ? crc
+                     : crc16Entry((crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1),
+                                  bits - 1);
+}
+
+// Развёртка 256 элементов инициализатора (без шаблонов C++14)
+#define CRC_T4(f, n)   f(n), f(n + 1), f(n + 2), f(n + 3)
+#define CRC_T16(f, n)  CRC_T4(f, n), CRC_T4(f, n + 4), CRC_T4(f, n + 8), CRC_T4(f, n + 12)
+#define CRC_T64(f, n)  CRC_T16(f, n), CRC_T16(f, n + 16), CRC_T16(f, n + 32), CRC_T16(f, n + 48)
+#define CRC_T256(f)    CRC_T64(f, 0), CRC_T64(f, 64), CRC_T64(f, 128), CRC_T64(f, 192)
+#define CRC8_E(i)      crc8Entry((uint8_t)(i))
+#define CRC16_E(i)     crc16Entry((uint16_t)((i) << 8))
+
+constexpr uint8_t  CRC8_TABLE[256]  = {CRC_T256(CRC8_E)};
+constexpr uint16_t CRC16_TABLE[256] = {CRC_T256(CRC16_E)};
+
+static_assert(CRC8_TABLE[1] == 0x07 && CRC8_TABLE[255] == 0xF3, "таблица CRC-8");
+static_assert(CRC16_TABLE[1] == 0x1021 && CRC16_TABLE[255] == 0x1EF0, "таблица CRC-16");
+
+}  // namespace
+
+uint8_t Crc::crc8(const uint8_t* data, size_t len, uint8_t crc) {
+    for (size_t i = 0; i < len; i++) crc = CRC8_TABLE[crc ^ data[i]];
+    return crc;
+}
+
+uint16_t Crc::crc16(const uint8_t* data, size_t len, uint16_t crc) {
+    for (size_t i = 0; i < len; i++) crc = (uint16_t)(crc << 8) ^ CRC16_TABLE[(crc >> 8) ^ data[i]];
+    return crc;
+}
+
+uint32_t Crc::crc32(const uint8_t* data, size_t len, uint32_t crc) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
@@ -0,0 +1,33 @@
+#ifndef CRC_H
+#define CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Табличные CRC для кадров RS485 и файлов архива.
+ *
+ * Таблицы на 256 значений строятся constexpr-функциями при компиляции и
+ * лежат во флеше. Счёт инкрементальный: CRC заголовка передаётся
+ * начальным значением в вызов для payload, копировать кадр не нужно.
+ *  - CRC-8: полином 0x07, начальное 0x00, без отражения и финального XOR;
+ *  - CRC-16/CCITT-FALSE: полином 0x1021, начальное 0xFFFF, без отражения;
+ *  - CRC-32 (IEEE 802.3): полубайтовая таблица, 64 байта вместо 1 КБ.
+ *    Продолжение — по результату прошлого вызова, как у zlib crc32().
+ */
+class Crc {
+public:
+    static const uint8_t  CRC8_INIT  = 0x00;
+    static const uint16_t CRC16_INIT = 0xFFFF;
+
+    /// Продолжить CRC-8 байтами data
+    static uint8_t crc8(const uint8_t* data, size_t len, uint8_t crc = CRC8_INIT);
+
+    /// Продолжить CRC-16/CCITT байтами data
+    static uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = CRC16_INIT);
+
+    /// Продолжить CRC-32 байтами data (crc — результат прошлого вызова, 0 для начала)
+    static uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+};
+
+#endif // CRC_H
@@ -0,0 +1,104 @@
+#include "DedupFilter.h"
+
+static_assert((DEDUP_BLOOM_BITS & (DEDUP_BLOOM_BITS - 1)) == 0 && DEDUP_BLOOM_BITS >= 32,
+              "DEDUP_BLOOM_BITS должен быть степенью двойки");
+static_assert(DEDUP_WINDOW > 0 && DEDUP_WINDOW < 0xFFFF, "DEDUP_WINDOW вне диапазона");
+
+void DedupFilter::clear() {
+    for (uint16_t i = 0; i < DEDUP_WINDOW; i++) _bucket[i] = NONE;
+    _ringHead   = 0;
+    _ringCount  = 0;
+    memset(_bloom, 0, sizeof(_bloom));
+    _bloomCur   = 0;
+    _bloomCount = 0;
+}
+
+uint64_t DedupFilter::_hash(const Key& k) {
+    // splitmix64 от упакованного ключа
+    uint64_t x = ((uint64_t)k.client_id << 32 | k.cow_id) ^ ((uint64_t)k.timestamp * 0x9E3779B97F4A7C15ULL);
+    x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+bool DedupFilter::_inWindow(const Key& k, uint64_t h) const {
+    for (uint16_t i = _bucket[h % DEDUP_WINDOW]; i != NONE; i = _next[i]) {
+        if (_ring[i] == k) return true;
+    }
+    return false;
+}
+
+bool DedupFilter::_inBloom(uint64_t h) const {
+    // Двойное хеширование: бит i = h1 + i * h2
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    for (uint8_t g = 0; g < 2; g++) {
+        bool all = true;
+        for (uint8_t i = 0; i < DEDUP_BLOOM_HASHES && all; i++) {
+            uint32_t bit = (h1 + i * h2) & (DEDUP_BLOOM_BITS - 1);
+            all = _bloom[g][bit / 32] & (1UL << (bit % 32));
+        }
+        if (all) return true;
+    }
+    return false;
+}
+
+DedupFilter::Verdict DedupFilter::check(const ArchiveRecord& record) {
+    Key      k = _key(record);
+    uint64_t h = _hash(k);
+    if (!_inBloom(h)) return NEW;
+    return _inWindow(k, h) ? DUPLICATE : MAYBE;
+}
+
+void DedupFilter::count(Verdict verdict) {
+    _stats.checked++;
+    if (verdict == DUPLICATE) _stats.duplicates++;
+    if (verdict == MAYBE)     _stats.maybe++;
+}
+
+void DedupFilter::remember(const ArchiveRecord& record) {
+    Key      k = _key(record);
+    uint64_t h = _hash(k);
+
+    // Окно полно — вытесняем самый старый ключ из его цепочки
+    uint16_t slot;
+    if (_ringCount < DEDUP_WINDOW) {
+        slot = (_ringHead + _ringCount++) % DEDUP_WINDOW;
+    } else {
+        slot      = _ringHead;
+        _ringHead = (_ringHead + 1) % DEDUP_WINDOW;
+        uint16_t* link = &_bucket[_hash(_ring[slot]) % DEDUP_WINDOW];
+        while (*link != NONE && *link != slot) link = &_next[*link];
+        if (*link == slot) *link = _next[slot];
+    }
+    _ring[slot] = k;
+    uint16_t& head = _bucket[h % DEDUP_WINDOW];
+    _next[slot] = head;
+    head        = slot;
+
+    // Поколение заполнено — старое очищается и становится текущим
+    if (_bloomCount >= DEDUP_BLOOM_GENERATION) {
+        _bloomCur ^= 1;
+        memset(_bloom[_bloomCur], 0, sizeof(_bloom[_bloomCur]));
+        _bloomCount = 0;
+    }
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    for (uint8_t i = 0; i < DEDUP_BLOOM_HASHES; i++) {
+        uint32_t bit = (h1 + i * h2) & (DEDUP_BLOOM_BITS - 1);
+        _bloom[_bloomCur][bit / 32] |= 1UL << (bit % 32);
+    }
+    _bloomCount++;
+}
+
+void DedupFilter::seed(ArchiveManager& archive) {
+    uint32_t end   = archive.endIndex();
+    uint32_t first = archive.firstIndex();
+    if (end - first > DEDUP_BLOOM_GENERATION) first = end - DEDUP_BLOOM_GENERATION;
+    uint32_t n = 0;
+    archive.visit(ArchiveFilter(), [&](uint32_t, const ArchiveRecord& rec) {
+        remember(rec);
+        n++;
+        return true;
+    }, first);
+    Serial.printf("[Dedup] Загружено %lu последних записей архива\n", (unsigned long)n);
+}
@@ -0,0 +1,106 @@
+#ifndef DEDUP_FILTER_H
+#define DEDUP_FILTER_H
+
+#include <Arduino.h>
+#include "ArchiveManager.h"
+
+// Точное окно: сколько последних принятых записей помнить поимённо
+#ifndef DEDUP_WINDOW
+#define DEDUP_WINDOW 256
+#endif
+// Размер одного поколения фильтра Блума, бит (степень двойки)
+#ifndef DEDUP_BLOOM_BITS
+#define DEDUP_BLOOM_BITS 16384
+#endif
+// Число хеш-функций фильтра Блума
+#ifndef DEDUP_BLOOM_HASHES
+#define DEDUP_BLOOM_HASHES 5
+#endif
+// Записей в поколении, после которых старое поколение очищается
+#ifndef DEDUP_BLOOM_GENERATION
+#define DEDUP_BLOOM_GENERATION 1024
+#endif
+
+/**
+ * @brief Статистика фильтра повторов.
+ */
+struct DedupStats {
+    uint32_t checked;      ///< Проверено записей
+    uint32_t duplicates;   ///< Отброшено повторов из точного окна
+    uint32_t maybe;        ///< Совпадений только по фильтру Блума (нужна проверка архивом)
+};
+
+/**
+ * @brief Отсев повторно присланных по RS485 записей на сервере.
+ *
+ * Ключ записи — (client_id, cow_id, timestamp). Два уровня, оба в RAM:
+ *  - точное окно из DEDUP_WINDOW последних ключей (кольцо + хеш-цепочки);
+ *  - фильтр Блума из двух поколений по DEDUP_BLOOM_BITS бит: покрывает
+ *    ~DEDUP_BLOOM_GENERATION..2*DEDUP_BLOOM_GENERATION последних записей.
+ * Ключ, которого нет в фильтре Блума, точно новый; найденный в окне — точно
+ * повтор. Совпадение только по фильтру Блума — MAYBE: это либо ложное
+ * срабатывание, либо старый повтор, и решает вызывающий (например, по архиву).
+ */
+class DedupFilter {
+public:
+    enum Verdict : uint8_t {
+        NEW,         ///< Запись не встречалась
+        DUPLICATE,   ///< Запись уже принята (в точном окне)
+        MAYBE        ///< Вероятно, повтор — проверить по архиву
+    };
+
+    DedupFilter() { clear(); }
+
+    /// Забыть все ключи
+    void clear();
+
+    /// Проверить запись, не запоминая её и не трогая статистику
+    Verdict check(const ArchiveRecord& record);
+
+    /// Учесть итог проверки в статистике — по разу на запись, а не на повтор проверки
+    void count(Verdict verdict);
+
+    /// Запомнить принятую запись
+    void remember(const ArchiveRecord& record);
+
+    /**
+     * @brief Заполнить фильтр хвостом архива (после перезагрузки).
+     * Читает не больше DEDUP_BLOOM_GENERATION последних записей.
+     */
+    void seed(ArchiveManager& archive);
+
+    const DedupStats& stats() const { return _stats; }
+
+private:
+    struct Key {
+        uint32_t client_id;
+        uint32_t cow_id;
+        uint32_t timestamp;
+        bool operator==(const Key& o) const {
+            return client_id == o.client_id && cow_id == o.cow_id && timestamp == o.timestamp;
+        }
+    };
+    static const uint16_t NONE = 0xFFFF;
+    static const uint32_t BLOOM_WORDS = DEDUP_BLOOM_BITS / 32;
+
+    // Точное окно: кольцо ключей и цепочки по корзинам хеша
+    Key      _ring[DEDUP_WINDOW];
+    uint16_t _next[DEDUP_WINDOW];      ///< Следующий слот кольца в той же корзине
+    uint16_t _bucket[DEDUP_WINDOW];    ///< Первый слот кольца в корзине
+    uint16_t _ringHead  = 0;
+    uint16_t _ringCount = 0;
+
+    // Фильтр Блума: текущее и предыдущее поколения
+    uint32_t _bloom[2][BLOOM_WORDS];
+    uint8_t  _bloomCur   = 0;
+    uint16_t _bloomCount = 0;
+
+    DedupStats _stats = {};
+
+    static Key      _key(const ArchiveRecord& r) { return {r.client_id, r.cow_id, r.timestamp}; }
+    static uint64_t _hash(const Key& k);
+    bool _inWindow(const Key& k, uint64_t h) const;
+    bool _inBloom(uint64_t h) const;
+};
+
+#endif
@@ -0,0 +1,301 @@
+#include "FlashEmulator.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// Содержимое файла и его след на эмулируемом флеше
+struct Node {
+    std::vector<uint8_t> data;
+    size_t placed = 0;     ///< Байт, уже размещённых в блоках данных (не inline)
+    bool   dirty  = false; ///< Изменения ещё не зафиксированы в метаданных
+};
+
+std::string parentOf(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == 0 || slash == std::string::npos ? "/" : path.substr(0, slash);
+}
+
+}  // namespace
+
+class FlashEmulatorImpl : public fs::FSImpl {
+public:
+    std::map<std::string, std::shared_ptr<Node>> files;
+    std::map<std::string, bool> dirs;
+    FlashStats stats = {0, 0, 0, 0};
+    uint32_t   metaFill = 0;   ///< Заполнение текущего блока метаданных
+
+    FlashEmulatorImpl() { dirs["/"] = true; }
+
+    /// Фиксация метаданных; payload — содержимое inline-файла
+    void commit(size_t payload) {
+        uint32_t n = FLASH_EMU_COMMIT + payload;
+        stats.commits++;
+        stats.programmed += n;
+        metaFill += n;
+        if (metaFill >= FLASH_EMU_BLOCK) {   // уплотнение пары блоков метаданных
+            stats.erases++;
+            metaFill = 0;
+        }
+    }
+
+    void sync(Node& node) {
+        if (!node.dirty) return;
+        node.dirty = false;
+        commit(node.data.size() <= FLASH_EMU_INLINE ? node.data.size() : 0);
+    }
+
+    /// Учесть запись [pos, pos + len) в блоки данных файла
+    void place(Node& node, size_t pos, size_t len) {
+        node.dirty = true;
+        size_t size = node.data.size();
+        if (size <= FLASH_EMU_INLINE) return;               // уйдёт с фиксацией
+        if (node.placed == 0) pos = 0;                      // вышел из inline: пишется целиком
+        size_t end = pos + len;
+        if (pos < node.placed) {
+            // Copy-on-write: изменённый блок и все следующие переписываются
+            size_t from = pos / FLASH_EMU_BLOCK * FLASH_EMU_BLOCK;
+            if (end < node.placed) end = node.placed;
+            stats.erases     += (end - 1) / FLASH_EMU_BLOCK - from / FLASH_EMU_BLOCK + 1;
+            stats.programmed += end - from;
+        } else {
+            // Дозапись: стирается каждый начатый заново блок
+            size_t fresh = node.placed ? (node.placed - 1) / FLASH_EMU_BLOCK + 1 : 0;
+            size_t last  = (end - 1) / FLASH_EMU_BLOCK;
+            if (last >= fresh) stats.erases += last - fresh + 1;
+            stats.programmed += end - node.placed;
+        }
+        if (end > node.placed) node.placed = end;
+    }
+
+    fs::FileImplPtr open(const char* path, const char* mode, const bool create) override;
+    bool exists(const char* path) override { return files.count(path) || dirs.count(path); }
+
+    bool rename(const char* pathFrom, const char* pathTo) override {
+        auto it = files.find(pathFrom);
+        if (it == files.end() || !dirs.count(parentOf(pathTo))) return false;
+        std::shared_ptr<Node> node = it->second;
+        files.erase(it);
+        files[pathTo] = node;
+        commit(0);
+        return true;
+    }
+
+    bool remove(const char* path) override {
+        if (!files.erase(path)) return false;
+        commit(0);
+        return true;
+    }
+
+    bool mkdir(const char* path) override {
+        if (exists(path) || !dirs.count(parentOf(path))) return false;
+        dirs[path] = true;
+        commit(0);
+        return true;
+    }
+
+    bool rmdir(const char* path) override {
+        std::string dir = path;
+        if (dir == "/" || !dirs.count(dir)) return false;
+        for (const auto& f : files) {
+            if (parentOf(f.first) == dir) return false;
+        }
+        for (const auto& d : dirs) {
+            if (d.first != dir && parentOf(d.first) == dir) return false;
+        }
+        dirs.erase(dir);
+        commit(0);
+        return true;
+    }
+};
+
+namespace {
+
+class EmuFile : public fs::FileImpl {
+public:
+    EmuFile(FlashEmulatorImpl* fs, const std::string& path, std::shared_ptr<Node> node,
+            bool readable, bool writable, bool append)
+        : _fs(fs), _path(path), _node(node), _read(readable), _write(writable), _append(append) {}
+    ~EmuFile() override { close(); }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!_open || !_write || !size) return 0;
+        std::vector<uint8_t>& d = _node->data;
+        if (_append) _pos = d.size();
+        if (d.size() < _pos + size) d.resize(_pos + size);
+        memcpy(d.data() + _pos, buf, size);
+        _fs->stats.written += size;
+        _fs->place(*_node, _pos, size);
+        _pos += size;
+        return size;
+    }
+
+    size_t read(uint8_t* buf, size_t size) override {
+        const std::vector<uint8_t>& d = _node->data;
+        if (!_open || !_read || _pos >= d.size()) return 0;
+        if (size > d.size() - _pos) size = d.size() - _pos;
+        memcpy(buf, d.data() + _pos, size);
+        _pos += size;
+        return size;
+    }
+
+    void flush() override {
+        if (_open) _fs->sync(*_node);
+    }
+
+    bool seek(uint32_t pos, fs::SeekMode mode) override {
+        if (!_open) return false;
+        switch (mode) {
+            case fs::SeekSet: _pos = pos; break;
+            case fs::SeekCur: _pos += pos; break;
+            case fs::SeekEnd: _pos = _node->data.size() + pos; break;
+        }
+        return true;
+    }
+
+    size_t position() const override { return _pos; }
+    size_t size() const override { return _node->data.size(); }
+    bool setBufferSize(size_t) override { return true; }
+
+    void close() override {
+        if (!_open) return;
+        _fs->sync(*_node);
+        _open = false;
+    }
+
+    time_t getLastWrite() override { return 0; }
+    const char* path() const override { return _path.c_str(); }
+    const char* name() const override { return _path.c_str() + _path.rfind('/') + 1; }
+    bool isDirectory(void) override { return false; }
+    fs::FileImplPtr openNextFile(const char*) override { return fs::FileImplPtr(); }
+    // Без override: в разных версиях ядра эти методы есть не везде
+    bool seekDir(long) { return false; }
+    String getNextFileName(void) { return String(); }
+    String getNextFileName(bool* isDir) {
+        if (isDir) *isDir = false;
+        return String();
+    }
+    void rewindDirectory(void) override {}
+    operator bool() override { return _open; }
+
+private:
+    FlashEmulatorImpl*    _fs;
+    std::string           _path;
+    std::shared_ptr<Node> _node;
+    size_t _pos    = 0;
+    bool   _read;
+    bool   _write;
+    bool   _append;
+    bool   _open   = true;
+};
+
+/// Каталог: снимок списка дочерних путей на момент открытия
+class EmuDir : public fs::FileImpl {
+public:
+    EmuDir(FlashEmulatorImpl* fs, const std::string& path) : _fs(fs), _path(path) {
+        for (const auto& f : fs->files) {
+            if (parentOf(f.first) == path) _entries.push_back(f.first);
+        }
+        for (const auto& d : fs->dirs) {
+            if (d.first != path && parentOf(d.first) == path) _entries.push_back(d.first);
+        }
+    }
+
+    size_t write(const uint8_t*, size_t) override { return 0; }
+    size_t read(uint8_t*, size_t) override { return 0; }
+    void flush() override {}
+    bool seek(uint32_t, fs::SeekMode) override { return false; }
+    size_t position() const override { return 0; }
+    size_t size() const override { return 0; }
+    bool setBufferSize(size_t) override { return false; }
+    void close() override { _open = false; }
+    time_t getLastWrite() override { return 0; }
+    const char* path() const override { return _path.c_str(); }
+    const char* name() const override { return _path.c_str() + _path.rfind('/') + 1; }
+    bool isDirectory(void) override { return true; }
+
+    fs::FileImplPtr openNextFile(const char* mode) override {
+        if (!_open || _next >= _entries.size()) return fs::FileImplPtr();
+        return _fs->open(_entries[_next++].c_str(), mode, false);
+    }
+    bool seekDir(long position) {
+        _next = position < 0 ? 0 : (size_t)position;
+        return _next <= _entries.size();
+    }
+    String getNextFileName(void) { return getNextFileName(nullptr); }
+    String getNextFileName(bool* isDir) {
+        if (!_open || _next >= _entries.size()) return String();
+        const std::string& p = _entries[_next++];
+        if (isDir) *isDir = _fs->dirs.count(p) > 0;
+        return String(p.c_str());
+    }
+    void rewindDirectory(void) override { _next = 0; }
+    operator bool() override { return _open; }
+
+private:
+    FlashEmulatorImpl*       _fs;
+    std::string              _path;
+    std::vector<std::string> _entries;
+    size_t _next = 0;
+    bool   _open = true;
+};
+
+}  // namespace
+
+fs::FileImplPtr FlashEmulatorImpl::open(const char* path, const char* mode, const bool create) {
+    std::string p = path;
+    if (dirs.count(p)) return std::make_shared<EmuDir>(this, p);
+
+    bool plus     = strchr(mode, '+') != nullptr;
+    bool readable = mode[0] == 'r' || plus;
+    bool writable = mode[0] != 'r' || plus;
+    auto it = files.find(p);
+    if (it == files.end()) {
+        if (mode[0] == 'r') return fs::FileImplPtr();
+        std::string dir = parentOf(p);
+        if (!dirs.count(dir)) {
+            if (!create) return fs::FileImplPtr();
+            // create = true: недостающие каталоги создаются по пути
+            for (size_t s = p.find('/', 1); s != std::string::npos; s = p.find('/', s + 1)) {
+                if (!dirs.count(p.substr(0, s))) mkdir(p.substr(0, s).c_str());
+            }
+        }
+        it = files.emplace(p, std::make_shared<Node>()).first;
+        it->second->dirty = true;
+    }
+    std::shared_ptr<Node> node = it->second;
+    if (mode[0] == 'w') {
+        // Усечение: блоки освобождаются, новые стираются при дозаписи
+        node->data.clear();
+        node->placed = 0;
+        node->dirty  = true;
+    }
+    return std::make_shared<EmuFile>(this, p, node, readable, writable, mode[0] == 'a');
+}
+
+FlashEmulator::FlashEmulator() : fs::FS(std::make_shared<FlashEmulatorImpl>()) {
+    _emu = static_cast<FlashEmulatorImpl*>(_impl.get());
+}
+
+FlashStats FlashEmulator::stats() const {
+    return _emu->stats;
+}
+
+void FlashEmulator::resetStats() {
+    _emu->stats    = {0, 0, 0, 0};
+    _emu->metaFill = 0;
+}
+
+void FlashEmulator::format() {
+    _emu->files.clear();
+    _emu->dirs.clear();
+    _emu->dirs["/"] = true;
+}
+
+size_t FlashEmulator::usedBytes() const {
+    size_t bytes = 0;
+    for (const auto& f : _emu->files) bytes += f.second->data.size();
+    return bytes;
+}
@@ -0,0 +1,69 @@
+#ifndef FLASH_EMULATOR_H
+#define FLASH_EMULATOR_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <FSImpl.h>
+
+// Размер стираемого блока флеша, байт
+#ifndef FLASH_EMU_BLOCK
+#define FLASH_EMU_BLOCK 4096
+#endif
+// Файлы не больше этого размера хранятся в метаданных (inline), байт
+#ifndef FLASH_EMU_INLINE
+#define FLASH_EMU_INLINE 512
+#endif
+// Накладные расходы одной фиксации метаданных (тег, указатели, CRC), байт
+#ifndef FLASH_EMU_COMMIT
+#define FLASH_EMU_COMMIT 32
+#endif
+
+/**
+ * @brief Счётчики износа эмулируемого флеша.
+ */
+struct FlashStats {
+    uint64_t written;      ///< Байт передано в write() — полезная нагрузка
+    uint64_t programmed;   ///< Байт запрограммировано (данные, копии блоков, метаданные)
+    uint32_t erases;       ///< Стёрто блоков
+    uint32_t commits;      ///< Фиксаций метаданных (close/flush изменённого файла, rename, remove)
+
+    /// Коэффициент усиления записи: programmed / written
+    float amplification() const { return written ? (float)programmed / written : 0.0f; }
+};
+
+class FlashEmulatorImpl;
+
+/**
+ * @brief Файловая система в RAM с приближённой моделью износа LittleFS.
+ *
+ * Подставляется вместо LittleFS в ArchiveManager::begin() (и любой код на
+ * fs::FS), чтобы мерить архив без реального флеша: на стенде без платы —
+ * с заглушками Arduino, на плате — не трогая раздел с данными.
+ *
+ * Модель (как в LittleFS, без учёта кэшей записи):
+ *  - блок стирается, когда файл начинает новый блок;
+ *  - запись внутри уже записанной части — copy-on-write: блоки от
+ *    изменённого до конца файла стираются и программируются заново;
+ *  - файлы до FLASH_EMU_INLINE байт живут в метаданных: их содержимое
+ *    пишется целиком при каждой фиксации;
+ *  - фиксация метаданных стоит FLASH_EMU_COMMIT байт; заполненный блок
+ *    метаданных уплотняется ценой одного стирания.
+ *
+ * Содержимое хранится в куче (на ESP32-S3 крупные буферы уходят в PSRAM).
+ */
+class FlashEmulator : public fs::FS {
+public:
+    FlashEmulator();
+
+    FlashStats stats() const;
+    void resetStats();
+    /// Удалить все файлы и каталоги (счётчики не сбрасываются)
+    void format();
+    /// Байт занято файлами
+    size_t usedBytes() const;
+
+private:
+    FlashEmulatorImpl* _emu;   ///< Владеет базовый fs::FS (_impl)
+};
+
+#endif
@@ -37,6 +37,9 @@ bool MQTTManager::connect() {
 
     if (success) {
         Serial.println("[MQTT] Connected ✅");
+        for (uint8_t i = 0; i < _topicCount; i++) {
+            _mqttClient.subscribe(_topics[i].c_str());
+        }
     } else {
         Serial.print("[MQTT] Failed ❌ rc=");
         Serial.println(_mqttClient.state());
@@ -64,6 +67,9 @@ bool MQTTManager::publish(const String& topic, const String& payload) {
 }
 
 bool MQTTManager::subscribe(const String& topic) {
+    bool known = false;
+    for (uint8_t i = 0; i < _topicCount && !known; i++) known = _topics[i] == topic;
+    if (!known && _topicCount < MAX_TOPICS) _topics[_topicCount++] = topic;
     if (!_mqttClient.connected()) return false;
 
     Serial.printf("[MQTT] Subscribing to %s\n", topic.c_str());
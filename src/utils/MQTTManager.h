@@ -51,6 +51,10 @@ public:
 
     /**
      * @brief Подписка на топик
+     *
+     * Топик запоминается (до MAX_TOPICS) и подписка повторяется при каждом
+     * подключении: брокер не хранит подписки clean-сессии после обрыва.
+     * @return true — если подписка отправлена брокеру сейчас
      */
     bool subscribe(const String& topic);
 
@@ -71,6 +75,10 @@ private:
 
     std::function<void(String, String)> _messageCallback;
 
+    static const uint8_t MAX_TOPICS = 4;
+    String  _topics[MAX_TOPICS];
+    uint8_t _topicCount = 0;
+
     static void _internalCallback(char* topic, byte* payload, unsigned int length);
     static MQTTManager* _instance;
 };
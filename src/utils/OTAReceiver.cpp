@@ -1,12 +1,13 @@
 #include "OTAReceiver.h"
 #include <LittleFS.h>
+#include "RS485OTAUpdater.h"
 OTAReceiver::OTAReceiver(RS485Manager& rs485)
   : _rs485(rs485) {}
 
 void OTAReceiver::handle() {
     uint8_t buf[150];
     size_t  len;
-    if (!_rs485.readRaw(buf, len)) return;
+    if (!_rs485.readRaw(buf, len, sizeof(buf))) return;
     processPayload(buf, len);
 }
 
@@ -14,31 +15,25 @@ void OTAReceiver::processPayload(const uint8_t* buf, size_t len) {
     if (len < 1) return;
     uint8_t type = buf[0];
 
-    if (type == 0x10 && !_updating && len == 1 + 4 + 2 + 2) {
-        // Header
-        struct {
-            uint8_t  t;
-            uint32_t totalSize;
-            uint16_t chunkSize;
-            uint16_t totalChunks;
-        } hdr;
-        memcpy(&hdr, buf, sizeof(hdr));
-        _fileSize    = hdr.totalSize;
-        _chunkSize   = hdr.chunkSize;
-        _totalChunks = hdr.totalChunks;
+    if (type == 0x10 && !_updating && len == RS485OTAUpdater::HEADER_SIZE) {
+        // Header: type | totalSize u32 | chunkSize u16 | totalChunks u16
+        memcpy(&_fileSize,    buf + 1, 4);
+        memcpy(&_chunkSize,   buf + 5, 2);
+        memcpy(&_totalChunks, buf + 7, 2);
         _recvChunks  = 0;
         // Открываем файл на запись
         _binFile = LittleFS.open("/fw.bin", FILE_WRITE);
         if (!_binFile) return;
         _updating = true;
     }
-    else if (type == 0x11 && _updating && len >= 1 + 2 + 2) {
-        // Chunk
+    else if (type == 0x11 && _updating && len >= RS485OTAUpdater::CHUNK_HEADER_SIZE) {
+        // Chunk: type | chunkIndex u16 | length u16 | данные
         uint16_t idx   = 0;
         uint16_t clen  = 0;
         memcpy(&idx,  buf + 1, 2);
         memcpy(&clen, buf + 3, 2);
-        const uint8_t* data = buf + 5;
+        if (clen != len - RS485OTAUpdater::CHUNK_HEADER_SIZE) return;   // обрезанный чанк
+        const uint8_t* data = buf + RS485OTAUpdater::CHUNK_HEADER_SIZE;
         // Позиционируемся в файле
         _binFile.seek((size_t)idx * _chunkSize);
         _binFile.write(data, clen);
@@ -14,6 +14,12 @@ public:
      */
     void handle();
 
+    /**
+     * @brief Обработать уже принятый payload, если это кадр OTA (0x10/0x11).
+     * Для задачи, которая сама разбирает шину (опрос ПУМ сервером).
+     */
+    void processPayload(const uint8_t* buf, size_t len);
+
 private:
     RS485Manager& _rs485;
     bool    _updating     = false;
@@ -22,8 +28,6 @@ private:
     uint16_t _totalChunks = 0;
     uint16_t _recvChunks  = 0;
     File    _binFile;
-
-    void processPayload(const uint8_t* buf, size_t len);
 };
 
 #endif // OTA_RECEIVER_H
@@ -0,0 +1,65 @@
+#include "RS485FrameDecoder.h"
+#include <string.h>
+
+RS485FrameDecoder::RS485FrameDecoder(uint8_t maxPayload)
+    : _maxPayload(maxPayload > RS485_MAX_PAYLOAD ? RS485_MAX_PAYLOAD : maxPayload) {}
+
+void RS485FrameDecoder::_drop(size_t count) {
+    size_t next = count;
+    while (next < _len && _buf[next] != START && _buf[next] != START16) next++;
+    _stats.skipped += next - count;
+    _len -= next;
+    memmove(_buf, _buf + next, _len);
+}
+
+bool RS485FrameDecoder::push(uint8_t byte) {
+    if (_len == 0 && byte != START && byte != START16) {
+        _stats.skipped++;
+        return false;
+    }
+    // Окно не длиннее одного кадра: poll() разбирает его после каждого байта
+    if (_len == FRAME_MAX) _drop(1);
+    _buf[_len++] = byte;
+    return poll();
+}
+
+bool RS485FrameDecoder::expire() {
+    // Целый кадр, оставшийся в окне после выданного, не трогаем
+    if (poll()) return true;
+    if (!_len) return false;
+    _stats.badFrames++;
+    _drop(1);
+    return poll();
+}
+
+bool RS485FrameDecoder::poll() {
+    while (_len >= 2) {
+        uint8_t len = _buf[1];
+        if (len > _maxPayload) {
+            _stats.badFrames++;
+            _drop(1);
+            continue;
+        }
+        bool   strong = _buf[0] == START16;
+        size_t total  = (size_t)len + (strong ? 5 : 4);
+        if (_len < total) return false;
+
+        const uint8_t* crc = _buf + 2 + len;
+        if (_buf[total - 1] != END) {
+            _stats.badFrames++;
+            _drop(1);
+        } else if (strong ? Crc::crc16(_buf, 2 + len) != (uint16_t)(crc[0] << 8 | crc[1])
+                          : Crc::crc8(_buf, 2 + len) != crc[0]) {
+            _stats.crcErrors++;
+            _drop(1);
+        } else {
+            memcpy(_frame, _buf + 2, len);
+            _frameLen = len;
+            _frameCrc16 = strong;
+            _stats.frames++;
+            _drop(total);
+            return true;
+        }
+    }
+    return false;
+}
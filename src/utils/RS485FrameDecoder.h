@@ -0,0 +1,95 @@
+#ifndef RS485_FRAME_DECODER_H
+#define RS485_FRAME_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Crc.h"
+
+// Наибольший payload кадра RS485, байт (поле Length — один байт)
+#ifndef RS485_MAX_PAYLOAD
+#define RS485_MAX_PAYLOAD 250
+#endif
+
+/**
+ * @brief Статистика разбора кадров RS485.
+ */
+struct RS485DecoderStats {
+    uint32_t frames;      ///< Принято целых кадров
+    uint32_t crcErrors;   ///< Кадров отброшено по CRC
+    uint32_t badFrames;   ///< Кадров отброшено по длине или End-байту
+    uint32_t skipped;     ///< Байт пропущено в поисках Start
+};
+
+/**
+ * @brief Побайтовый разборщик кадров RS485.
+ *
+ * Два вида кадра, различаются Start-байтом:
+ *   0xAA | Length | payload | CRC-8 | 0x55
+ *   0xAB | Length | payload | CRC-16/CCITT (старший байт первым) | 0x55
+ * CRC считается по Start, Length и payload (см. Crc). CRC-16 — для длинных
+ * кадров (OTA), где 8 бит ловят случайную порчу хуже.
+ *
+ * Не читает UART и никогда не ждёт: вызывающий подаёт столько байт, сколько
+ * пришло, push() сообщает о собранном кадре. Байты кадра-кандидата держатся
+ * в окне; если кадр не сошёлся (CRC, End, длина), поиск Start продолжается
+ * со следующего байта окна, а не после отброшенного кадра — ложный 0xAA в
+ * мусоре или внутри payload не съедает следующий настоящий кадр.
+ *
+ * Окно может содержать ещё один целый кадр после выданного: его отдаёт
+ * poll() (или следующий push()). Пауза в потоке посреди кадра — повод
+ * вызвать expire().
+ */
+class RS485FrameDecoder {
+public:
+    static const uint8_t START   = 0xAA;   ///< Кадр с CRC-8
+    static const uint8_t START16 = 0xAB;   ///< Кадр с CRC-16
+    static const uint8_t END     = 0x55;
+
+    /// @param maxPayload кадры длиннее отбрасываются (не больше RS485_MAX_PAYLOAD)
+    explicit RS485FrameDecoder(uint8_t maxPayload = RS485_MAX_PAYLOAD);
+
+    /**
+     * @brief Подать очередной байт.
+     * @return true — собран кадр: payload()/length() действительны до
+     *         следующего push()/poll()
+     */
+    bool push(uint8_t byte);
+
+    /// Разобрать то, что уже лежит в окне, без новых байт
+    bool poll();
+
+    /**
+     * @brief Незаконченный кадр так и не дошёл (пауза в потоке).
+     *
+     * Его Start считается ложным: ложный 0xAA с большой длиной иначе
+     * держал бы в окне настоящие кадры, пока не придёт столько байт.
+     * Разбор продолжается со следующего байта окна; вызывать, пока busy().
+     * @return true — собран кадр
+     */
+    bool expire();
+
+    /// В окне есть начатый кадр
+    bool busy() const { return _len > 0; }
+
+    const uint8_t* payload() const { return _frame; }
+    uint8_t length() const { return _frameLen; }
+    /// Выданный кадр защищён CRC-16
+    bool crc16() const { return _frameCrc16; }
+    RS485DecoderStats stats() const { return _stats; }
+
+private:
+    static const size_t FRAME_MAX = RS485_MAX_PAYLOAD + 5;
+
+    uint8_t  _buf[FRAME_MAX];      ///< Окно: начинается с Start кадра-кандидата
+    size_t   _len = 0;
+    uint8_t  _frame[RS485_MAX_PAYLOAD];
+    uint8_t  _frameLen = 0;
+    bool     _frameCrc16 = false;
+    uint8_t  _maxPayload;
+    RS485DecoderStats _stats = {0, 0, 0, 0};
+
+    /// Убрать из окна count байт и всё до следующего Start
+    void _drop(size_t count);
+};
+
+#endif // RS485_FRAME_DECODER_H
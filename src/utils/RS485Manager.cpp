@@ -36,22 +36,6 @@ void RS485Manager::_enableReceive() {
     digitalWrite(_dePin, LOW);
 }
 
-// CRC8 (полином 0x07) для массива байт
-uint8_t RS485Manager::_calcCRC8(const uint8_t* data, size_t len) const {
-    uint8_t crc = 0x00;
-    for (size_t i = 0; i < len; i++) {
-        crc ^= data[i];
-        for (uint8_t b = 0; b < 8; b++) {
-            if (crc & 0x80) {
-                crc = (crc << 1) ^ 0x07;
-            } else {
-                crc <<= 1;
-            }
-        }
-    }
-    return crc;
-}
-
 // Отправка одного пакета
 bool RS485Manager::sendPacket(const RS485Packet& pkt) {
     if (!_serial) return false;
@@ -102,7 +86,7 @@ bool RS485Manager::sendPacket(const RS485Packet& pkt) {
     packet[p++] = PAYLOAD_LEN;
     memcpy(&packet[p], payload, PAYLOAD_LEN);
     p += PAYLOAD_LEN;
-    uint8_t crc = _calcCRC8(packet, 2 + PAYLOAD_LEN);
+    uint8_t crc = Crc::crc8(packet, 2 + PAYLOAD_LEN);
     packet[p++] = crc;
     packet[p++] = 0x55;
 
@@ -115,98 +99,86 @@ bool RS485Manager::sendPacket(const RS485Packet& pkt) {
     return true;
 }
 
-bool RS485Manager::sendRaw(const uint8_t* buf, size_t len) {
-    if (!_serial) return false;
-    size_t total = 1 + 1 + len + 1 + 1;
-    uint8_t* pkt = (uint8_t*)malloc(total);
-    if (!pkt) return false;
+bool RS485Manager::sendRaw(const uint8_t* buf, size_t len, bool crc16) {
+    RS485Slice part = {buf, len};
+    return sendFrame(&part, 1, crc16);
+}
 
-    size_t i = 0;
-    pkt[i++] = 0xAA;          // Start
-    pkt[i++] = (uint8_t)len;  // Length
-    memcpy(pkt + i, buf, len);
-    i += len;
-    uint8_t crc = _calcCRC8(pkt, 2 + len);
-    pkt[i++] = crc;           // CRC
-    pkt[i++] = 0x55;          // End
+bool RS485Manager::sendFrame(const RS485Slice* parts, size_t count, bool crc16) {
+    if (!_serial) return false;
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) len += parts[i].len;
+    if (len > RS485_MAX_PAYLOAD) return false;
+
+    // CRC считается по заголовку и кускам по месту, без копии кадра
+    uint8_t  head[2] = {crc16 ? RS485FrameDecoder::START16 : RS485FrameDecoder::START, (uint8_t)len};
+    uint16_t crc     = crc16 ? Crc::crc16(head, sizeof(head)) : Crc::crc8(head, sizeof(head));
+    for (size_t i = 0; i < count; i++) {
+        crc = crc16 ? Crc::crc16(parts[i].data, parts[i].len, crc)
+                    : Crc::crc8(parts[i].data, parts[i].len, (uint8_t)crc);
+    }
+    uint8_t tail[3];
+    size_t  t = 0;
+    if (crc16) tail[t++] = crc >> 8;
+    tail[t++] = crc & 0xFF;
+    tail[t++] = RS485FrameDecoder::END;
 
     _enableTransmit();
-    _serial->write(pkt, total);
+    _serial->write(head, sizeof(head));
+    for (size_t i = 0; i < count; i++) {
+        if (parts[i].len) _serial->write(parts[i].data, parts[i].len);
+    }
+    _serial->write(tail, t);
     _serial->flush();
     _enableReceive();
-
-    free(pkt);
     return true;
 }
 
-bool RS485Manager::readRaw(uint8_t* outBuf, size_t& outLen) {
+bool RS485Manager::_receive() {
     if (!_serial) return false;
-    uint32_t start = millis();
-    // Ждём Start
-    while (millis() - start < _timeout) {
-        if (_serial->available() && _serial->read() == 0xAA) break;
+    if (_decoder.poll()) return true;
+    // Хвост кадра так и не пришёл — не ждём его дольше _timeout. Байты,
+    // уже лежащие в UART, — продолжение кадра, сколько бы они ни ждали
+    if (_serial->available() <= 0 && millis() - _lastByte > _timeout) {
+        while (_decoder.busy()) {
+            if (_decoder.expire()) return true;
+        }
+    }
+    while (_serial->available() > 0) {
+        int c = _serial->read();
+        if (c < 0) break;
+        _lastByte = millis();
+        if (_decoder.push((uint8_t)c)) return true;
+    }
+    return false;
+}
+
+bool RS485Manager::readRaw(uint8_t* outBuf, size_t& outLen, size_t maxLen) {
+    while (_receive()) {
+        if (_decoder.length() > maxLen) continue;   // не влезает в буфер вызывающего
+        outLen = _decoder.length();
+        memcpy(outBuf, _decoder.payload(), outLen);
+        return true;
     }
-    if (millis() - start >= _timeout) return false;
-
-    // Читаем Length
-    uint8_t len;
-    if (!_serial->readBytes(&len, 1)) return false;
-    outLen = len;
-    if (len > 250) return false; // защита
-
-    // Читаем payload
-    if (_serial->readBytes(outBuf, len) < len) return false;
-
-    // Читаем CRC
-    uint8_t recvCrc = 0;
-    if (!_serial->readBytes(&recvCrc, 1)) return false;
-
-    // Читаем End
-    uint8_t endByte = 0;
-    if (!_serial->readBytes(&endByte, 1) || endByte != 0x55) return false;
-
-    // Проверяем CRC
-    uint8_t* tmp = (uint8_t*)malloc(2 + len);
-    tmp[0] = 0xAA;
-    tmp[1] = len;
-    memcpy(tmp + 2, outBuf, len);
-    uint8_t calc = _calcCRC8(tmp, 2 + len);
-    free(tmp);
-    return calc == recvCrc;
+    return false;
 }
+
 // Чтение и парсинг одного полного пакета
 bool RS485Manager::readPacket(RS485Packet& out_pkt) {
-    if (!_serial) return false;
-    uint32_t start = millis();
-
-    // 1) Ждём Start
-    while (millis() - start < _timeout) {
-        if (_serial->available() && _serial->read() == 0xAA) break;
+    const size_t PAYLOAD_LEN = 20;
+    const uint8_t* payload = nullptr;
+    while (!payload && _receive()) {
+        if (_decoder.length() == PAYLOAD_LEN) payload = _decoder.payload();
     }
-    if (millis() - start >= _timeout) return false;
-
-    // 2) Читаем Length
-    uint8_t length;
-    if (!_serial->readBytes(&length, 1)) return false;
-    if (length != 20) return false;  // теперь 20 байт payload!
-
-    // 3) Читаем payload
-    uint8_t payload[20];
-    if (_serial->readBytes(payload, 20) < 20) return false;
-
-    // 4) Читаем CRC и End
-    uint8_t recvCrc = 0, endByte = 0;
-    if (!_serial->readBytes(&recvCrc, 1)) return false;
-    if (_serial->readBytes(&endByte, 1) != 1 || endByte != 0x55) return false;
-
-    // 5) Проверяем CRC
-    uint8_t tmp[2 + 20];
-    tmp[0] = 0xAA;
-    tmp[1] = 20;
-    memcpy(tmp + 2, payload, 20);
-    if (_calcCRC8(tmp, sizeof(tmp)) != recvCrc) return false;
-
-    // 6) Распаковываем
+    if (!payload) return false;
+
+    return parsePacket(payload, PAYLOAD_LEN, out_pkt);
+}
+
+bool RS485Manager::parsePacket(const uint8_t* payload, size_t len, RS485Packet& out_pkt) {
+    if (len != 20) return false;
+
+    // Распаковываем
     size_t i = 0;
     out_pkt.client_id = ((uint32_t)payload[i++] << 24)
                       | ((uint32_t)payload[i++] << 16)
@@ -232,3 +204,26 @@ bool RS485Manager::readPacket(RS485Packet& out_pkt) {
     return true;
 }
 
+bool RS485Manager::sendPoll(uint8_t addr, bool ack, uint32_t ackTs) {
+    if (!ack) ackTs = 0;
+    uint8_t payload[RS485_POLL_LEN] = {
+        RS485_POLL, addr, (uint8_t)(ack ? RS485_POLL_ACK : 0),
+        (uint8_t)(ackTs >> 24), (uint8_t)(ackTs >> 16), (uint8_t)(ackTs >> 8), (uint8_t)ackTs
+    };
+    return sendRaw(payload, sizeof(payload));
+}
+
+bool RS485Manager::sendPollIdle(uint8_t addr) {
+    uint8_t payload[2] = {RS485_POLL_IDLE, addr};
+    return sendRaw(payload, sizeof(payload));
+}
+
+bool RS485Manager::parsePoll(const uint8_t* payload, size_t len, uint8_t& addr,
+                             bool& ack, uint32_t& ackTs) {
+    if (len != RS485_POLL_LEN || payload[0] != RS485_POLL) return false;
+    addr  = payload[1];
+    ack   = (payload[2] & RS485_POLL_ACK) != 0;
+    ackTs = ((uint32_t)payload[3] << 24) | ((uint32_t)payload[4] << 16)
+          | ((uint32_t)payload[5] <<  8) |  (uint32_t)payload[6];
+    return true;
+}
@@ -2,6 +2,7 @@
 #define RS485_MANAGER_H
 
 #include <Arduino.h>
+#include "RS485FrameDecoder.h"
 
 /**
  * @brief Пакет данных (payload) для бинарного протокола RS485.
@@ -17,8 +18,38 @@ struct RS485Packet {
         : client_id(0), cow_id(0), liters(0.0f), timestamp(0), ec(0.0f) {}
 };
 
+/**
+ * @brief Опрос ведомых по шине (ведущий — сервер).
+ *
+ * Сервер по очереди опрашивает адреса ПУМ (ConfigManager::getClientID()
+ * каждого клиента), клиент передаёт только в ответ на свой опрос:
+ *   опрос:      0x20 | addr | flags | ackTs u32 BE — при RS485_POLL_ACK
+ *               в flags ackTs = timestamp записи, принятой от addr на
+ *               прошлом опросе; без флага ackTs не смотрится
+ *   ответ:      пакет RS485Packet (20 байт) — старейшая неотправленная запись
+ *   нет данных: 0x21 | addr
+ * Запись помечается отправленной только по подтверждению, потерянный ответ
+ * повторяется на следующем опросе (повторы сервер отсеивает). Флаг нужен,
+ * чтобы и запись с timestamp 0 (часы не выставлены) могла быть подтверждена.
+ */
+#define RS485_POLL      0x20   ///< Опрос ведомого
+#define RS485_POLL_IDLE 0x21   ///< Ответ «данных нет»
+#define RS485_POLL_LEN  7      ///< Длина payload опроса
+#define RS485_POLL_ACK  0x01   ///< flags: ackTs подтверждает запись
+
+/**
+ * @brief Кусок payload для RS485Manager::sendFrame().
+ */
+struct RS485Slice {
+    const uint8_t* data;
+    size_t         len;
+};
+
 /**
  * @brief Менеджер RS485 с бинарным протоколом.
+ *
+ * Ни отправка, ни приём не обращаются к куче: кадр собирается из буферов
+ * вызывающего прямо в UART, принятый payload копируется в его буфер.
  */
 class RS485Manager {
 public:
@@ -36,21 +67,34 @@ public:
     void begin(uint8_t rxPin, uint8_t txPin, uint32_t baud, uint8_t dePin);
    /* **
     * @brief Отправить «сырые» данные по RS485, обёрнутые в Start/Len/CRC/End
+    * @param crc16 true — кадр с CRC-16/CCITT (Start 0xAB), для длинных кадров
     */
-   bool sendRaw(const uint8_t* buf, size_t len);
+   bool sendRaw(const uint8_t* buf, size_t len, bool crc16 = false);
 
    /**
-    * @brief Прочитать «сырые» данные из RS485.
+    * @brief Отправить один кадр, payload которого — подряд идущие куски.
+    *
+    * Например, заголовок и данные чанка OTA уходят одним кадром без
+    * сборки в промежуточный буфер; CRC считается по кускам.
+    * @param parts кусков count, суммарно не больше RS485_MAX_PAYLOAD байт
+    * @param crc16 true — кадр с CRC-16/CCITT (Start 0xAB)
+    * @return false, если UART не настроен или payload слишком длинный
+    */
+   bool sendFrame(const RS485Slice* parts, size_t count, bool crc16 = false);
+
+   /**
+    * @brief Прочитать «сырые» данные из RS485 (не блокируется).
     * @param outBuf Буфер для payload (без Start/Len/CRC/End).
     * @param outLen Сюда запишется длина payload.
-    * @return true, если пакет успешно считан и CRC проверен.
+    * @param maxLen Размер outBuf; более длинный кадр отбрасывается.
+    * @return true, если собран целый кадр с верным CRC.
     */
-   bool readRaw(uint8_t* outBuf, size_t& outLen);
+   bool readRaw(uint8_t* outBuf, size_t& outLen, size_t maxLen = RS485_MAX_PAYLOAD);
 
 
 
     /**
-     * @brief Проверяет, есть ли хотя бы один полный пакет в буфере.
+     * @brief Проверяет, пришли ли в UART новые байты.
      * 
      * @return true, если хотя бы один байт доступен (пакет может быть не полный).
      * @return false, если буфер пуст.
@@ -58,15 +102,17 @@ public:
     bool available();
 
     /**
-     * @brief Читает один пакет из UART-потока.
+     * @brief Читает один пакет из UART-потока (не блокируется).
      * 
-     * Ждёт последовательности байтов:
+     * Забирает из UART все пришедшие байты и подаёт их в RS485FrameDecoder:
      *   0xAA | Length | payload... | CRC8 | 0x55
-     * Если пакет не валиден (CRC, End-байт), продолжает поиск следующего 0xAA.
+     * Незаконченный кадр ждёт следующего вызова; битые кадры и мусор
+     * пропускаются с поиском следующего 0xAA. Кадры другой длины
+     * (не 20 байт) отбрасываются.
      * 
      * @param out_pkt Сюда записывается разобранный RS485Packet (payload).
-     * @return true, если успешно прочитан и разобран целый пакет.
-     * @return false, если за отведённый timeout пакет не собрался.
+     * @return true, если разобран целый пакет.
+     * @return false, если целого пакета пока нет.
      */
     bool readPacket(RS485Packet& out_pkt);
 
@@ -83,6 +129,31 @@ public:
      */
     bool sendPacket(const RS485Packet& pkt);
 
+    /**
+     * @brief Разобрать payload длиной 20 байт в RS485Packet.
+     * @return false, если длина не та.
+     */
+    static bool parsePacket(const uint8_t* payload, size_t len, RS485Packet& out_pkt);
+
+    /**
+     * @brief Опросить ведомого addr (сервер).
+     * @param ack   true — подтвердить запись, принятую от addr на прошлом опросе
+     * @param ackTs её timestamp (без ack не передаётся по смыслу)
+     */
+    bool sendPoll(uint8_t addr, bool ack, uint32_t ackTs);
+
+    /**
+     * @brief Ответить на опрос «данных нет» (клиент).
+     */
+    bool sendPollIdle(uint8_t addr);
+
+    /**
+     * @brief Разобрать кадр опроса.
+     * @return false, если это не опрос.
+     */
+    static bool parsePoll(const uint8_t* payload, size_t len, uint8_t& addr,
+                          bool& ack, uint32_t& ackTs);
+
     /**
      * @brief Проверяет, доступен ли канал (UART настроен).
      * 
@@ -93,27 +164,27 @@ public:
     bool isConnected() const;
 
     /**
-     * @brief Устанавливает timeout для чтения одного полного пакета.
+     * @brief Устанавливает паузу, после которой незаконченный кадр сбрасывается.
      * 
      * @param ms Таймаут в миллисекундах.
      */
     void setTimeout(uint16_t ms);
 
+    /// Счётчики принятых и отброшенных кадров
+    RS485DecoderStats decoderStats() const { return _decoder.stats(); }
+
 private:
     HardwareSerial* _serial = nullptr; ///< Указатель на UART (Serial2)
     uint8_t         _dePin   = 0;      ///< Пин DE/RE трансивера
-    uint16_t        _timeout = 100;    ///< Таймаут чтения (ms)
+    uint16_t        _timeout = 100;    ///< Пауза внутри кадра, после которой он сбрасывается (ms)
+    RS485FrameDecoder _decoder;        ///< Разбор входящего потока
+    uint32_t        _lastByte = 0;     ///< millis() последнего принятого байта
 
     /**
-     * @brief Вычисляет CRC8 для массива байтов.
-     * 
-     * Использует полином 0x07 (стандарт CRC-8).
-     * 
-     * @param data Указатель на байты.
-     * @param len  Длина в байтах.
-     * @return uint8_t — значение CRC8.
+     * @brief Подать в разборщик пришедшие байты, пока не соберётся кадр.
+     * @return true — кадр в _decoder.payload()
      */
-    uint8_t _calcCRC8(const uint8_t* data, size_t len) const;
+    bool _receive();
 
     /**
      * @brief Включает режим передачи: DE = HIGH.
@@ -14,19 +14,15 @@ bool RS485OTAUpdater::begin(const String& path) {
 }
 
 void RS485OTAUpdater::sendHeader() {
-    // Пакет типа 0x10 — заголовок OTA
-    struct {
-        uint8_t  type;         // 0x10
-        uint32_t totalSize;
-        uint16_t chunkSize;
-        uint16_t totalChunks;
-    } hdr;
-    hdr.type        = 0x10;
-    hdr.totalSize   = _totalSize;
-    hdr.chunkSize   = _chunkSize;
-    hdr.totalChunks = _totalChunks;
+    // Пакет типа 0x10 — заголовок OTA, 9 байт без выравнивания (little-endian):
+    // type | totalSize u32 | chunkSize u16 | totalChunks u16
+    uint8_t hdr[HEADER_SIZE];
+    hdr[0] = 0x10;
+    memcpy(hdr + 1, &_totalSize, 4);
+    memcpy(hdr + 5, &_chunkSize, 2);
+    memcpy(hdr + 7, &_totalChunks, 2);
 
-    _rs485.sendRaw((uint8_t*)&hdr, sizeof(hdr));
+    _rs485.sendRaw(hdr, sizeof(hdr), RS485_OTA_CRC16);
 }
 
 bool RS485OTAUpdater::sendNextChunk() {
@@ -34,20 +30,16 @@ bool RS485OTAUpdater::sendNextChunk() {
         _fwFile.close();
         return false;
     }
-    size_t len = _fwFile.read(_buffer, _chunkSize);
-    // Пакет типа 0x11 — чанк OTA
-    struct {
-        uint8_t  type;        // 0x11
-        uint16_t chunkIndex;
-        uint16_t length;
-    } pktHdr;
-    pktHdr.type       = 0x11;
-    pktHdr.chunkIndex = _currentChunk;
-    pktHdr.length     = len;
+    uint16_t len = _fwFile.read(_buffer, _chunkSize);
+    // Пакет типа 0x11 — чанк OTA: type | chunkIndex u16 | length u16 | данные
+    uint8_t hdr[CHUNK_HEADER_SIZE];
+    hdr[0] = 0x11;
+    memcpy(hdr + 1, &_currentChunk, 2);
+    memcpy(hdr + 3, &len, 2);
 
-    // отправляем hdr + данные
-    _rs485.sendRaw((uint8_t*)&pktHdr, sizeof(pktHdr));
-    _rs485.sendRaw(_buffer, len);
+    // Заголовок и данные — один кадр, без копирования в общий буфер
+    RS485Slice parts[2] = {{hdr, sizeof(hdr)}, {_buffer, len}};
+    if (!_rs485.sendFrame(parts, 2, RS485_OTA_CRC16)) return false;
 
     _currentChunk++;
     return true;
@@ -4,6 +4,11 @@
 #include <LittleFS.h>
 #include "RS485Manager.h"
 
+// 1 — кадры OTA идут с CRC-16/CCITT (Start 0xAB), 0 — с CRC-8 как прочие
+#ifndef RS485_OTA_CRC16
+#define RS485_OTA_CRC16 1
+#endif
+
 class RS485OTAUpdater {
 public:
     RS485OTAUpdater(RS485Manager& rs485);
@@ -20,6 +25,9 @@ public:
      */
     bool sendNextChunk();
 
+    static const size_t HEADER_SIZE       = 9;   ///< Кадр-заголовок OTA (0x10)
+    static const size_t CHUNK_HEADER_SIZE = 5;   ///< Заголовок кадра-чанка (0x11) перед данными
+
 private:
     RS485Manager& _rs485;
     File          _fwFile;
@@ -0,0 +1,483 @@
+#include "RollupStore.h"
+#include "ArchiveManager.h"
+#include "Crc.h"
+#include <algorithm>
+#include <new>
+#include <vector>
+
+bool RollupStore::begin(fs::FS& fs, const String& dir) {
+    _fs  = &fs;
+    _dir = dir;
+    _dirtyCount = 0;
+    _foldedDay  = 0;
+    _firstDay   = 0;
+    if (!_fs->exists(_dir) && !_fs->mkdir(_dir)) {
+        Serial.printf("[Rollup] Не удалось создать каталог %s\n", _dir.c_str());
+        return false;
+    }
+    if (!_loadJournal()) {
+        // Без журнала (или с журналом прежнего формата) неизвестно, что уже
+        // учтено — считаем всё заново
+        clear();
+    }
+    return true;
+}
+
+uint32_t RollupStore::dayOf(uint32_t timestamp) {
+    return (uint32_t)(((int64_t)timestamp + ROLLUP_DAY_OFFSET) / 86400);
+}
+
+String RollupStore::_dayPath(uint32_t day) const {
+    char name[16];
+    snprintf(name, sizeof(name), "/%08lX.day", (unsigned long)day);
+    return _dir + name;
+}
+
+void RollupStore::_merge(RollupRow& into, const RollupRow& delta) {
+    if (delta.sessions == 0) return;
+    if (into.sessions == 0) {
+        into = delta;
+        return;
+    }
+    into.sessions += delta.sessions;
+    into.volume   += delta.volume;
+    into.ec_sum   += delta.ec_sum;
+    if (delta.ec_min < into.ec_min) into.ec_min = delta.ec_min;
+    if (delta.ec_max > into.ec_max) into.ec_max = delta.ec_max;
+}
+
+bool RollupStore::add(const ArchiveRecord& record) {
+    uint32_t day = dayOf(record.timestamp);
+    RollupRow d{record.cow_id, 1, 0, record.volume, record.ec, record.ec, record.ec};
+
+    Delta* slot = nullptr;
+    for (uint16_t i = 0; i < _dirtyCount && !slot; i++) {
+        if (_dirty[i].day == day && _dirty[i].row.cow_id == record.cow_id) slot = &_dirty[i];
+    }
+    if (slot) {
+        _merge(slot->row, d);
+    } else {
+        if (_dirtyCount >= ROLLUP_DIRTY_MAX) return false;
+        _dirty[_dirtyCount++] = {day, d};
+    }
+
+    // Начались новые сутки — прошлые свернутся при следующем flush()
+    if (day > _lastDay) _lastDay = day;
+    return true;
+}
+
+bool RollupStore::flush(uint32_t rolledEnd) {
+    if (!_fs) return false;
+    if (_dirtyCount || rolledEnd != _rolledEnd) {
+        // Одна пачка за сброс: приращения и индекс, до которого они учтены
+        size_t bytes = (size_t)_dirtyCount * sizeof(Delta);
+        BatchHeader h{JOURNAL_MAGIC, rolledEnd, _lastDay, _dirtyCount, 0, 0};
+        h.crc = Crc::crc32((const uint8_t*)&h, sizeof(h), Crc::crc32((const uint8_t*)_dirty, bytes));
+        File f = _fs->open(_dir + "/journal", "a");
+        bool ok = f && f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h)
+                    && f.write((const uint8_t*)_dirty, bytes) == bytes;
+        if (f) f.close();
+        if (!ok) {
+            Serial.println("[Rollup] Ошибка записи итогов");
+            // Недописанную пачку отрезаем, иначе следующие легли бы за ней
+            _rewriteJournal([](const Delta&) { return true; });
+            return false;
+        }
+        _journalBytes += sizeof(h) + bytes;
+        for (uint16_t i = 0; i < _dirtyCount; i++) _noteJournalDay(_dirty[i].day);
+        _dirtyCount = 0;
+        _rolledEnd  = rolledEnd;
+    }
+
+    // Свёртка: закончились сутки — их приращения в файлы суток; журнал
+    // разросся или помнит слишком много суток — все, включая текущие
+    bool full = _journalBytes > ROLLUP_JOURNAL_MAX || _journalDayCount >= ROLLUP_JOURNAL_DAYS;
+    bool old  = false;
+    for (uint8_t i = 0; i < _journalDayCount && i < ROLLUP_JOURNAL_DAYS; i++) {
+        old |= _journalDays[i] != _lastDay;
+    }
+    if (full || (old && _foldedDay != _lastDay)) {
+        _fold(full);   // при ошибке приращения остаются в журнале — ничего не теряется
+    }
+    return true;
+}
+
+void RollupStore::_noteJournalDay(uint32_t day) {
+    if (_inJournal(day)) return;
+    if (_journalDayCount < ROLLUP_JOURNAL_DAYS) _journalDays[_journalDayCount] = day;
+    if (_journalDayCount <= ROLLUP_JOURNAL_DAYS) _journalDayCount++;
+}
+
+bool RollupStore::_inJournal(uint32_t day) const {
+    if (_journalDayCount > ROLLUP_JOURNAL_DAYS) return true;   // список переполнен
+    for (uint8_t i = 0; i < _journalDayCount; i++) {
+        if (_journalDays[i] == day) return true;
+    }
+    return false;
+}
+
+bool RollupStore::_scanJournal(std::function<bool(const BatchHeader&, const Delta&)> fn) {
+    if (!_journalBytes) return true;
+    File f = _fs->open(_dir + "/journal", "r");
+    if (!f) return false;
+    static const uint16_t CHUNK = 8;
+    Delta  chunk[CHUNK];
+    size_t pos  = 0;
+    bool   more = true;
+    while (more && pos + sizeof(BatchHeader) <= _journalBytes) {
+        BatchHeader h;
+        if (f.read((uint8_t*)&h, sizeof(h)) != sizeof(h)) {
+            more = false;
+            break;
+        }
+        for (uint16_t done = 0; more && done < h.count; ) {
+            uint16_t n = h.count - done < CHUNK ? h.count - done : CHUNK;
+            more = f.read((uint8_t*)chunk, n * sizeof(Delta)) == n * sizeof(Delta);
+            for (uint16_t i = 0; more && i < n; i++) more = fn(h, chunk[i]);
+            done += n;
+        }
+        pos += sizeof(h) + (size_t)h.count * sizeof(Delta);
+    }
+    f.close();
+    return more;
+}
+
+bool RollupStore::_loadJournal() {
+    _rolledEnd       = 0;
+    _lastDay         = 0;
+    _journalBytes    = 0;
+    _journalDayCount = 0;
+    String path = _dir + "/journal";
+    if (!_fs->exists(path)) return false;
+    File f = _fs->open(path, "r");
+    if (!f) return false;
+
+    // Пачки по порядку до первой неполной или испорченной (сбой при записи)
+    static const uint16_t CHUNK = 8;
+    Delta  chunk[CHUNK];
+    size_t size = f.size();
+    size_t pos  = 0;
+    while (pos + sizeof(BatchHeader) <= size) {
+        BatchHeader h;
+        if (f.read((uint8_t*)&h, sizeof(h)) != sizeof(h) || h.magic != JOURNAL_MAGIC || h.count > BATCH_MAX) break;
+        uint32_t crc = 0;
+        bool ok = true;
+        for (uint16_t done = 0; ok && done < h.count; ) {
+            uint16_t n = h.count - done < CHUNK ? h.count - done : CHUNK;
+            ok = f.read((uint8_t*)chunk, n * sizeof(Delta)) == n * sizeof(Delta);
+            crc = Crc::crc32((const uint8_t*)chunk, n * sizeof(Delta), crc);
+            // Сутки отбракованной пачки тоже попадут в список — это лишь лишнее чтение
+            for (uint16_t i = 0; ok && i < n; i++) _noteJournalDay(chunk[i].day);
+            done += n;
+        }
+        uint32_t stored = h.crc;
+        h.crc = 0;
+        if (!ok || Crc::crc32((const uint8_t*)&h, sizeof(h), crc) != stored) break;
+        pos       += sizeof(h) + (size_t)h.count * sizeof(Delta);
+        _rolledEnd = h.rolled_end;
+        _lastDay   = h.last_day;
+    }
+    f.close();
+    _journalBytes = pos;
+    if (!pos) return false;
+    if (pos < size) {
+        Serial.printf("[Rollup] Неполная пачка в журнале итогов отброшена (%u байт)\n",
+                      (unsigned)(size - pos));
+        return _rewriteJournal([](const Delta&) { return true; });
+    }
+    return true;
+}
+
+bool RollupStore::_rewriteJournal(std::function<bool(const Delta&)> keep) {
+    String path = _dir + "/journal";
+    String tmp  = _dir + "/journal.tmp";
+    File out = _fs->open(tmp, "w");
+    if (!out) return false;
+
+    // Заголовок пачки дописывается, когда известны число приращений и CRC
+    BatchHeader h{JOURNAL_MAGIC, _rolledEnd, _lastDay, 0, 0, 0};
+    size_t   hdrPos = 0;
+    uint32_t crc    = 0;
+    bool     ok     = out.write((const uint8_t*)&h, sizeof(h)) == sizeof(h);
+    auto closeBatch = [&]() {
+        h.crc = 0;
+        h.crc = Crc::crc32((const uint8_t*)&h, sizeof(h), crc);
+        size_t end = out.position();
+        ok = ok && out.seek(hdrPos, SeekSet) && out.write((const uint8_t*)&h, sizeof(h)) == sizeof(h)
+                && out.seek(end, SeekSet);
+    };
+    uint8_t dayCount = 0;
+    uint32_t days[ROLLUP_JOURNAL_DAYS];
+    ok = ok && _scanJournal([&](const BatchHeader&, const Delta& d) {
+        if (!keep(d)) return true;
+        if (h.count == BATCH_MAX) {
+            closeBatch();
+            hdrPos  = out.position();
+            h.count = 0;
+            crc     = 0;
+            ok = ok && out.write((const uint8_t*)&h, sizeof(h)) == sizeof(h);
+        }
+        ok = ok && out.write((const uint8_t*)&d, sizeof(d)) == sizeof(d);
+        crc = Crc::crc32((const uint8_t*)&d, sizeof(d), crc);
+        h.count++;
+        bool known = false;
+        for (uint8_t i = 0; i < dayCount && i < ROLLUP_JOURNAL_DAYS; i++) known |= days[i] == d.day;
+        if (!known && dayCount < ROLLUP_JOURNAL_DAYS) days[dayCount] = d.day;
+        if (!known && dayCount <= ROLLUP_JOURNAL_DAYS) dayCount++;
+        return ok;
+    });
+    closeBatch();
+    size_t bytes = out.position();
+    out.close();
+    ok = ok && _fs->rename(tmp, path);
+    if (!ok) {
+        _fs->remove(tmp);
+        Serial.println("[Rollup] Не удалось переписать журнал итогов");
+        return false;
+    }
+    _journalBytes    = bytes;
+    _journalDayCount = dayCount;
+    memcpy(_journalDays, days, sizeof(days));
+    return true;
+}
+
+bool RollupStore::_fold(bool all) {
+    // Сворачиваемые сутки — из списка, а если он переполнен — по журналу
+    std::vector<uint32_t> days;
+    if (_journalDayCount > ROLLUP_JOURNAL_DAYS) {
+        _scanJournal([&](const BatchHeader&, const Delta& d) {
+            if (std::find(days.begin(), days.end(), d.day) == days.end()) days.push_back(d.day);
+            return true;
+        });
+    } else {
+        days.assign(_journalDays, _journalDays + _journalDayCount);
+    }
+    if (!all) days.erase(std::remove(days.begin(), days.end(), _lastDay), days.end());
+    if (days.empty()) return true;
+
+    bool ok = true;
+    for (uint32_t day : days) {
+        // Удалённые prune() сутки не сворачиваем — их приращения просто уходят
+        if (day >= _firstDay && !_foldDay(day)) ok = false;
+    }
+    // Свёрнутое в файлах суток отмечено folded_end, так что журнал можно
+    // переписать и позже: повторно эти приращения не учтутся
+    if (!ok) return false;
+    ok = _rewriteJournal([&](const Delta& d) {
+        return std::find(days.begin(), days.end(), d.day) == days.end();
+    });
+    if (ok) _foldedDay = _lastDay;
+    return ok;
+}
+
+bool RollupStore::_readDayHeader(File& f, uint32_t day, DayHeader& hdr) {
+    return f.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) && hdr.magic == DAY_MAGIC
+           && hdr.day == day && f.size() == sizeof(hdr) + (size_t)hdr.rows * sizeof(RollupRow);
+}
+
+bool RollupStore::_foldDay(uint32_t day) {
+    String path = _dayPath(day);
+    DayHeader hdr{DAY_MAGIC, day, 0, 0};
+    File in;
+    if (_fs->exists(path)) {
+        in = _fs->open(path, "r");
+        if (in && !_readDayHeader(in, day, hdr)) {
+            in.close();
+            hdr = {DAY_MAGIC, day, 0, 0};
+        }
+    }
+    // Приращения, ещё не попавшие в файл суток
+    uint32_t fresh = 0;
+    _scanJournal([&](const BatchHeader& h, const Delta& d) {
+        fresh += d.day == day && h.rolled_end > hdr.folded_end;
+        return true;
+    });
+    if (!fresh) {
+        if (in) in.close();
+        return true;
+    }
+
+    size_t total = (size_t)hdr.rows + fresh;
+    RollupRow* rows = new (std::nothrow) RollupRow[total];
+    if (!rows) {
+        if (in) in.close();
+        return false;
+    }
+    size_t n  = 0;
+    bool   ok = true;
+    if (in) {
+        ok = in.read((uint8_t*)rows, hdr.rows * sizeof(RollupRow)) == hdr.rows * sizeof(RollupRow);
+        in.close();
+        n = hdr.rows;
+    }
+    ok = ok && _scanJournal([&](const BatchHeader& h, const Delta& d) {
+        if (d.day == day && h.rolled_end > hdr.folded_end && n < total) rows[n++] = d.row;
+        return true;
+    });
+    // Строки одной коровы после сортировки соседние — сливаем их
+    std::sort(rows, rows + n, [](const RollupRow& a, const RollupRow& b) { return a.cow_id < b.cow_id; });
+    size_t out = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (out && rows[out - 1].cow_id == rows[i].cow_id) _merge(rows[out - 1], rows[i]);
+        else rows[out++] = rows[i];
+    }
+
+    // Через временный файл: при сбое остаётся прежний файл суток и журнал
+    String tmp = _dir + "/fold.tmp";
+    File f = ok ? _fs->open(tmp, "w") : File();
+    ok = ok && f;
+    if (ok) {
+        DayHeader nh{DAY_MAGIC, day, _rolledEnd, (uint32_t)out};
+        ok = f.write((const uint8_t*)&nh, sizeof(nh)) == sizeof(nh)
+             && f.write((const uint8_t*)rows, out * sizeof(RollupRow)) == out * sizeof(RollupRow);
+        f.close();
+        ok = ok && _fs->rename(tmp, path);
+        if (!ok) _fs->remove(tmp);
+    }
+    delete[] rows;
+    if (!ok) Serial.printf("[Rollup] Не удалось свернуть сутки %lu\n", (unsigned long)day);
+    return ok;
+}
+
+void RollupStore::clear() {
+    File root = _fs->open(_dir);
+    std::vector<String> names;
+    for (File f = root.openNextFile(); f; f = root.openNextFile()) {
+        String name = f.name();
+        f.close();
+        int slash = name.lastIndexOf('/');
+        if (slash >= 0) name = name.substring(slash + 1);
+        names.push_back(name);
+    }
+    root.close();
+    for (const String& name : names) _fs->remove(_dir + "/" + name);
+    _dirtyCount      = 0;
+    _rolledEnd       = 0;
+    _lastDay         = 0;
+    _foldedDay       = 0;
+    _firstDay        = 0;
+    _journalBytes    = 0;
+    _journalDayCount = 0;
+}
+
+uint32_t RollupStore::prune(uint32_t beforeDay) {
+    if (!_fs || beforeDay <= _firstDay) return 0;
+    _firstDay = beforeDay;
+    File root = _fs->open(_dir);
+    std::vector<String> names;
+    for (File f = root.openNextFile(); f; f = root.openNextFile()) {
+        String name = f.name();
+        f.close();
+        int slash = name.lastIndexOf('/');
+        if (slash >= 0) name = name.substring(slash + 1);
+        if (name.endsWith(".day") && strtoul(name.c_str(), nullptr, 16) < beforeDay) names.push_back(name);
+    }
+    root.close();
+    for (const String& name : names) _fs->remove(_dir + "/" + name);
+    // Приращения удалённых суток уйдут из журнала при следующей свёртке
+    if (!names.empty()) {
+        Serial.printf("[Rollup] Удалены итоги %u суток раньше %lu\n",
+                      (unsigned)names.size(), (unsigned long)beforeDay);
+    }
+    return names.size();
+}
+
+bool RollupStore::_findRow(File& f, const DayHeader& hdr, uint32_t cowId, RollupRow& out) {
+    size_t lo = 0, hi = hdr.rows;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (!f.seek(sizeof(hdr) + mid * sizeof(RollupRow), SeekSet)
+            || f.read((uint8_t*)&out, sizeof(out)) != sizeof(out)) {
+            return false;
+        }
+        if (out.cow_id == cowId) return true;
+        if (out.cow_id < cowId) lo = mid + 1;
+        else hi = mid;
+    }
+    return false;
+}
+
+bool RollupStore::_readDayRow(uint32_t cowId, uint32_t day, RollupRow& out, uint32_t& foldedEnd) {
+    memset(&out, 0, sizeof(out));
+    foldedEnd = 0;
+    String path = _dayPath(day);
+    if (!_fs->exists(path)) return false;
+    File f = _fs->open(path, "r");
+    DayHeader hdr;
+    if (f && _readDayHeader(f, day, hdr)) {
+        foldedEnd = hdr.folded_end;
+        if (!_findRow(f, hdr, cowId, out)) memset(&out, 0, sizeof(out));
+    }
+    if (f) f.close();
+    return out.sessions > 0;
+}
+
+bool RollupStore::get(uint32_t cowId, uint32_t day, RollupRow& out) {
+    memset(&out, 0, sizeof(out));
+    if (!_fs || day < _firstDay) return false;
+    uint32_t foldedEnd;
+    _readDayRow(cowId, day, out, foldedEnd);
+    // Ещё не свёрнутые приращения журнала
+    if (_inJournal(day)) {
+        _scanJournal([&](const BatchHeader& h, const Delta& d) {
+            if (h.rolled_end > foldedEnd && d.day == day && d.row.cow_id == cowId) _merge(out, d.row);
+            return true;
+        });
+    }
+    // Ещё не сброшенные приращения
+    for (uint16_t i = 0; i < _dirtyCount; i++) {
+        if (_dirty[i].day == day && _dirty[i].row.cow_id == cowId) _merge(out, _dirty[i].row);
+    }
+    return out.sessions > 0;
+}
+
+RollupRow RollupStore::range(uint32_t cowId, uint32_t fromDay, uint32_t toDay,
+                             std::function<bool(uint32_t, const RollupRow&)> fn) {
+    RollupRow total;
+    memset(&total, 0, sizeof(total));
+    total.cow_id = cowId;
+    if (!_fs) return total;
+    if (toDay > _lastDay) toDay = _lastDay;
+    if (toDay >= ROLLUP_MAX_RANGE && fromDay < toDay - ROLLUP_MAX_RANGE + 1) {
+        fromDay = toDay - ROLLUP_MAX_RANGE + 1;
+    }
+    if (fromDay < _firstDay) fromDay = _firstDay;
+    if (fromDay > toDay) return total;
+
+    // Строки из файлов суток, затем один проход журнала на весь период
+    // (а не по проходу на каждые сутки, как в get())
+    uint32_t  days = toDay - fromDay + 1;
+    uint32_t* foldedEnd = new (std::nothrow) uint32_t[days];
+    RollupRow* rows     = new (std::nothrow) RollupRow[days];
+    if (!foldedEnd || !rows) {
+        delete[] foldedEnd;
+        delete[] rows;
+        return total;
+    }
+    bool journal = false;
+    for (uint32_t i = 0; i < days; i++) {
+        _readDayRow(cowId, fromDay + i, rows[i], foldedEnd[i]);
+        journal |= _inJournal(fromDay + i);
+    }
+    if (journal) {
+        _scanJournal([&](const BatchHeader& h, const Delta& d) {
+            if (d.row.cow_id == cowId && d.day >= fromDay && d.day <= toDay
+                && h.rolled_end > foldedEnd[d.day - fromDay]) {
+                _merge(rows[d.day - fromDay], d.row);
+            }
+            return true;
+        });
+    }
+    for (uint16_t i = 0; i < _dirtyCount; i++) {
+        const Delta& d = _dirty[i];
+        if (d.row.cow_id == cowId && d.day >= fromDay && d.day <= toDay) _merge(rows[d.day - fromDay], d.row);
+    }
+    for (uint32_t i = 0; i < days; i++) {
+        if (!rows[i].sessions) continue;
+        _merge(total, rows[i]);
+        if (fn && !fn(fromDay + i, rows[i])) break;
+    }
+    delete[] foldedEnd;
+    delete[] rows;
+    return total;
+}
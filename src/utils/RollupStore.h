@@ -0,0 +1,180 @@
+#ifndef ROLLUP_STORE_H
+#define ROLLUP_STORE_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+struct ArchiveRecord;
+
+// Сколько несброшенных пар (корова, сутки) держать в RAM.
+// Не меньше буфера группового коммита архива: каждая запись меняет одну пару
+#ifndef ROLLUP_DIRTY_MAX
+#define ROLLUP_DIRTY_MAX 64
+#endif
+// Самый длинный период для RollupStore::range(), суток: на каждые сутки —
+// открытие файла суток под мьютексом архива
+#ifndef ROLLUP_MAX_RANGE
+#define ROLLUP_MAX_RANGE 62
+#endif
+// Сдвиг начала суток относительно UTC, секунд (например, 3 * 3600 для МСК)
+#ifndef ROLLUP_DAY_OFFSET
+#define ROLLUP_DAY_OFFSET 0
+#endif
+// Журнал приращений длиннее этого (байт) сворачивается в файлы суток,
+// не дожидаясь смены суток
+#ifndef ROLLUP_JOURNAL_MAX
+#define ROLLUP_JOURNAL_MAX 32768
+#endif
+// Сколько разных суток журнал помнит в RAM, чтобы get() читал его только для них
+#ifndef ROLLUP_JOURNAL_DAYS
+#define ROLLUP_JOURNAL_DAYS 8
+#endif
+
+/**
+ * @brief Суточные итоги по одной корове.
+ */
+struct RollupRow {
+    uint32_t cow_id;
+    uint16_t sessions;   ///< Число доений за сутки
+    uint16_t reserved;
+    float    volume;     ///< Суммарный надой, л
+    float    ec_min;
+    float    ec_max;
+    float    ec_sum;     ///< Для среднего: ec_sum / sessions
+
+    float ecMean() const { return sessions ? ec_sum / sessions : 0.0f; }
+};
+
+/**
+ * @brief Суточные итоги по коровам в LittleFS.
+ *
+ * add() только копит приращения в RAM, flush() (ArchiveManager вызывает его
+ * вместе со своим сбросом) дописывает их одной пачкой в журнал
+ * <dir>/journal. В заголовке пачки — индекс архива, до которого итоги
+ * учтены, и CRC32: пачка целиком либо есть, либо отбрасывается, поэтому
+ * после сбоя хвост архива досчитывается ровно один раз.
+ *
+ * Когда наступают следующие сутки (или журнал вырос до ROLLUP_JOURNAL_MAX),
+ * приращения закончившихся суток сворачиваются в файл <dir>/DDDDDDDD.day
+ * (номер суток в hex) со строками RollupRow, отсортированными по cow_id, —
+ * поиск в нём двоичный. Файл пишется целиком через временный, журнал
+ * переписывается без свёрнутых суток. В заголовке файла суток — индекс
+ * архива, по который в него свёрнуты пачки: свёртка, прерванная сбоем,
+ * при повторе не учтёт их второй раз.
+ *
+ * Итоги за сутки, от которых в архиве не осталось записей, удаляет prune().
+ */
+class RollupStore {
+public:
+    /**
+     * @brief Открыть хранилище итогов.
+     * @return false, если каталог недоступен
+     */
+    bool begin(fs::FS& fs, const String& dir);
+
+    /// Номер суток для timestamp (с учётом ROLLUP_DAY_OFFSET)
+    static uint32_t dayOf(uint32_t timestamp);
+
+    /**
+     * @brief Учесть запись архива (только в RAM).
+     * @return false, если буфер приращений полон — нужен flush()
+     */
+    bool add(const ArchiveRecord& record);
+
+    /**
+     * @brief Дописать накопленные приращения в журнал.
+     * @param rolledEnd индекс архива, до которого учтены записи
+     */
+    bool flush(uint32_t rolledEnd);
+
+    bool isDirty() const { return _dirtyCount > 0; }
+
+    /// Индекс архива, до которого итоги лежат на флеше
+    uint32_t rolledEnd() const { return _rolledEnd; }
+
+    /// Удалить все итоги (перед пересчётом из архива)
+    void clear();
+
+    /**
+     * @brief Удалить итоги суток раньше beforeDay.
+     * @return число удалённых файлов суток
+     */
+    uint32_t prune(uint32_t beforeDay);
+
+    /**
+     * @brief Итоги коровы за сутки.
+     * @return false, если в эти сутки доений не было
+     */
+    bool get(uint32_t cowId, uint32_t day, RollupRow& out);
+
+    /**
+     * @brief Итоги коровы по дням за [fromDay, toDay].
+     * Период ограничен ROLLUP_MAX_RANGE сутками до последних суток с записями.
+     * @param fn колбэк (сутки, итоги); вернуть false, чтобы остановить
+     * @return сумма за период (ec_min/ec_max — по всему периоду)
+     */
+    RollupRow range(uint32_t cowId, uint32_t fromDay, uint32_t toDay,
+                    std::function<bool(uint32_t, const RollupRow&)> fn = nullptr);
+
+private:
+    /// Файл суток: заголовок и строки RollupRow по возрастанию cow_id
+    struct DayHeader {
+        uint32_t magic;
+        uint32_t day;
+        uint32_t folded_end;  ///< Свёрнуты пачки журнала с rolled_end не больше этого
+        uint32_t rows;
+    };
+    struct Delta {
+        uint32_t  day;
+        RollupRow row;
+    };
+    /// Пачка журнала: заголовок и count приращений
+    struct BatchHeader {
+        uint32_t magic;
+        uint32_t rolled_end;  ///< Индекс архива, до которого учтены записи
+        uint32_t last_day;
+        uint16_t count;
+        uint16_t reserved;
+        uint32_t crc;         ///< CRC32 приращений, продолженный заголовком (crc = 0)
+    };
+    static const uint32_t DAY_MAGIC     = 0x44524D41; // "AMRD"
+    static const uint32_t JOURNAL_MAGIC = 0x4A524D41; // "AMRJ"
+    static const uint16_t BATCH_MAX     = 4096;       ///< Приращений в пачке (свёртка пишет одну большую)
+
+    fs::FS*  _fs = nullptr;
+    String   _dir;
+    Delta    _dirty[ROLLUP_DIRTY_MAX];
+    uint16_t _dirtyCount = 0;
+    uint32_t _rolledEnd  = 0;
+    uint32_t _lastDay    = 0;   ///< Последние сутки, в которые были записи
+    uint32_t _foldedDay  = 0;   ///< _lastDay на момент последней свёртки
+    uint32_t _firstDay   = 0;   ///< Итоги раньше этих суток удалены prune()
+    size_t   _journalBytes = 0;
+    uint32_t _journalDays[ROLLUP_JOURNAL_DAYS]; ///< Сутки, приращения которых есть в журнале
+    uint8_t  _journalDayCount = 0;   ///< > ROLLUP_JOURNAL_DAYS — список переполнен
+
+    String _dayPath(uint32_t day) const;
+    static void _merge(RollupRow& into, const RollupRow& delta);
+    /// Запомнить, что в журнале есть приращения суток day
+    void   _noteJournalDay(uint32_t day);
+    bool   _inJournal(uint32_t day) const;
+    /**
+     * @brief Обход приращений журнала по пачкам (только проверенная при
+     * begin() часть). fn(заголовок пачки, приращение); false — остановить.
+     */
+    bool   _scanJournal(std::function<bool(const BatchHeader&, const Delta&)> fn);
+    /// Проверить журнал при загрузке; рваную последнюю пачку отрезать
+    bool   _loadJournal();
+    /// Переписать журнал: оставить приращения, для которых keep() == true
+    bool   _rewriteJournal(std::function<bool(const Delta&)> keep);
+    /// Свернуть приращения в файлы суток: закончившихся или (all) всех
+    bool   _fold(bool all);
+    bool   _foldDay(uint32_t day);
+    bool   _readDayHeader(File& f, uint32_t day, DayHeader& hdr);
+    /// Строка коровы из файла суток (без журнала) и folded_end файла
+    bool   _readDayRow(uint32_t cowId, uint32_t day, RollupRow& out, uint32_t& foldedEnd);
+    /// Найти строку коровы в файле суток (двоичный поиск)
+    bool   _findRow(File& f, const DayHeader& hdr, uint32_t cowId, RollupRow& out);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Кольцевая очередь без блокировок на одного писателя и одного читателя.
+ *
+ * push() вызывает только задача-производитель, pop()/peek() — только задача-
+ * потребитель; каждая из них пишет лишь свой счётчик, другой читает его с
+ * acquire. Счётчики растут непрерывно, позиция в буфере — счётчик & (N - 1).
+ *
+ * @tparam T тип элемента (копируемый)
+ * @tparam N ёмкость, степень двойки
+ */
+template <typename T, uint32_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "ёмкость SpscQueue — степень двойки");
+
+public:
+    /// Положить элемент (производитель). @return false, если очередь полна
+    bool push(const T& item) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= N) return false;
+        _buf[head & (N - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Забрать элемент (потребитель). @return false, если очередь пуста
+    bool pop(T& out) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) return false;
+        out = _buf[tail & (N - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Посмотреть первый элемент, не забирая (потребитель). @return false, если пусто
+    bool peek(T& out) const {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) return false;
+        out = _buf[tail & (N - 1)];
+        return true;
+    }
+
+    /// Число элементов (из любой задачи — приблизительно)
+    uint32_t size() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr uint32_t capacity() { return N; }
+
+private:
+    T _buf[N];
+    std::atomic<uint32_t> _head{0};   ///< Пишет только производитель
+    std::atomic<uint32_t> _tail{0};   ///< Пишет только потребитель
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "ArchiveBench.h"
+#include "FlashEmulator.h"
+
+// Стенд архива на ПК (env:native): те же прогоны, что в env:archive-bench,
+// плюс пороги износа — чтобы возврат к стиранию блока на каждую запись
+// (перезапись строк RollupStore на месте) ловился тестом
+
+void setUp() {}
+void tearDown() {}
+
+// Дозапись стирает только новые блоки, перезапись середины — copy-on-write до конца файла
+static void test_flash_emulator_model() {
+    FlashEmulator flash;
+    uint8_t block[FLASH_EMU_BLOCK];
+    memset(block, 0xA5, sizeof(block));
+
+    File f = flash.open("/f", "w", true);
+    TEST_ASSERT_TRUE((bool)f);
+    for (int i = 0; i < 4; i++) f.write(block, sizeof(block));
+    f.close();
+    FlashStats s = flash.stats();
+    TEST_ASSERT_EQUAL_UINT32(4, s.erases);
+    TEST_ASSERT_EQUAL_UINT64(4 * FLASH_EMU_BLOCK, s.written);
+
+    flash.resetStats();
+    f = flash.open("/f", "r+");
+    f.seek(FLASH_EMU_BLOCK + 10);
+    f.write(block, 8);
+    f.close();
+    s = flash.stats();
+    TEST_ASSERT_EQUAL_UINT32(3, s.erases);                      // блоки 1..3
+    TEST_ASSERT_GREATER_OR_EQUAL(3 * FLASH_EMU_BLOCK, (uint32_t)s.programmed);
+    TEST_ASSERT_EQUAL_UINT32(4 * FLASH_EMU_BLOCK, flash.usedBytes());
+}
+
+static void test_bench_small() {
+    ArchiveBenchResult r = ArchiveBench::run(1000);
+    TEST_ASSERT_TRUE(r.ok);
+    TEST_ASSERT_EQUAL_UINT32(1000, r.records);
+    // Доли микросекунды не округляются в ноль
+    TEST_ASSERT_TRUE(r.add_us > 0.0f);
+    TEST_ASSERT_TRUE(r.add_max_us >= r.add_us);
+    TEST_ASSERT_TRUE(r.next_us > 0.0f);
+    TEST_ASSERT_TRUE(r.update_us > 0.0f);
+    TEST_ASSERT_TRUE(r.recovery_ms > 0.0f);
+}
+
+static void test_bench_wear() {
+    ArchiveBenchResult r = ArchiveBench::run(10000);
+    TEST_ASSERT_TRUE(r.ok);
+    char msg[96];
+    snprintf(msg, sizeof(msg), "add %.1f B/rec %.4f erase/rec, ack %.1f B/rec",
+             r.add_bytes, r.add_erases, r.ack_bytes);
+    TEST_MESSAGE(msg);
+    // Запись: ~100 байт и ~0.03 стирания; до журнала итогов было ~4 КБ и ~1 стирание
+    TEST_ASSERT_TRUE_MESSAGE(r.add_erases < 0.1f, "add: стирание блока почти на каждую запись");
+    TEST_ASSERT_TRUE(r.add_bytes < 512.0f);
+    // Подтверждение: байт статуса в сегменте и группа в state
+    TEST_ASSERT_TRUE(r.ack_bytes < 64.0f);
+}
+
+static void test_bench_report() {
+    ArchiveBench::report(Serial);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_flash_emulator_model);
+    RUN_TEST(test_bench_small);
+    RUN_TEST(test_bench_wear);
+    RUN_TEST(test_bench_report);
+    return UNITY_END();
+}
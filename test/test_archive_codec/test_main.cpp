@@ -0,0 +1,193 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <vector>
+#include "ArchiveCodec.h"
+#include "FlashEmulator.h"
+
+// Колоночный кодек архива на ПК (env:native): точный возврат записей в
+// обоих режимах столбцов, zigzag-разности времени, отказ на обрезанных и
+// порченых данных, скорость распаковки. Файлы — FlashEmulator в RAM
+
+typedef std::vector<uint8_t> Bytes;
+
+static const uint16_t BLOCK = ARCHIVE_CODEC_MAX_BLOCK;
+static const uint32_t TS_BASE = 1700000000;
+
+static FlashEmulator flash;
+
+static Bytes encode(const ArchiveRecord* recs, uint16_t count) {
+    File f = flash.open("/blk", "w", true);
+    TEST_ASSERT_TRUE(ArchiveCodec::encodeBlock(f, recs, count));
+    f.close();
+    f = flash.open("/blk", "r");
+    Bytes b(f.size());
+    f.read(b.data(), b.size());
+    f.close();
+    return b;
+}
+
+static bool decode(const Bytes& data, ArchiveRecord* recs, uint16_t count) {
+    File f = flash.open("/in", "w", true);
+    if (!data.empty()) f.write(data.data(), data.size());
+    f.close();
+    f = flash.open("/in", "r");
+    bool ok = ArchiveCodec::decodeBlock(f, recs, count);
+    f.close();
+    return ok;
+}
+
+static void assertSame(const ArchiveRecord* a, const ArchiveRecord* b, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_UINT32(a[i].client_id, b[i].client_id);
+        TEST_ASSERT_EQUAL_UINT32(a[i].cow_id, b[i].cow_id);
+        TEST_ASSERT_EQUAL_UINT32(a[i].timestamp, b[i].timestamp);
+        TEST_ASSERT_FLOAT_WITHIN(0.5f / ArchiveCodec::FIXED_SCALE, a[i].volume, b[i].volume);
+        TEST_ASSERT_FLOAT_WITHIN(0.5f / ArchiveCodec::FIXED_SCALE, a[i].ec, b[i].ec);
+        TEST_ASSERT_EQUAL_UINT8(a[i].status, b[i].status);
+    }
+}
+
+// Похоже на доение: один ПУМ, разные коровы, время растёт на секунды
+static void milkingBlock(ArchiveRecord* recs, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+        recs[i] = {3, 1000 + esp_random() % 400, TS_BASE + i * 37 + esp_random() % 20,
+                   (float)(esp_random() % 3000) / 100.0f, 4.0f + (float)(esp_random() % 300) / 100.0f,
+                   (uint8_t)(i < count / 2 ? 1 : 0)};
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Одинаковые значения — все столбцы в RLE, блок занимает единицы байт
+static void test_roundtrip_rle() {
+    ArchiveRecord in[BLOCK], out[BLOCK];
+    for (uint16_t i = 0; i < BLOCK; i++) in[i] = {7, 42, TS_BASE, 12.5f, 5.25f, 1};
+    Bytes b = encode(in, BLOCK);
+    TEST_ASSERT_EQUAL_UINT8(1, b[0]);          // режим столбца client_id — RLE
+    TEST_ASSERT_TRUE(b.size() < 48);           // 6 столбцов по 1-2 серии
+    TEST_ASSERT_TRUE(decode(b, out, BLOCK));
+    assertSame(in, out, BLOCK);
+}
+
+// Все значения разные — столбцы подряд в varint
+static void test_roundtrip_plain() {
+    ArchiveRecord in[BLOCK], out[BLOCK];
+    for (uint16_t i = 0; i < BLOCK; i++) {
+        in[i] = {esp_random(), esp_random(), esp_random(),
+                 (float)(int32_t)(esp_random() % 2000000 - 1000000) / 100.0f,
+                 (float)(esp_random() % 100000) / 100.0f, (uint8_t)(i % 3)};
+    }
+    Bytes b = encode(in, BLOCK);
+    TEST_ASSERT_EQUAL_UINT8(0, b[0]);          // режим столбца client_id — подряд
+    TEST_ASSERT_TRUE(decode(b, out, BLOCK));
+    assertSame(in, out, BLOCK);
+}
+
+// Время назад, на месте и через переполнение uint32 — zigzag-разности
+static void test_roundtrip_timestamps() {
+    const uint32_t ts[] = {TS_BASE, TS_BASE, TS_BASE - 1, TS_BASE + 3600, 0, UINT32_MAX, 1,
+                           0x80000000, 0x7FFFFFFF, TS_BASE};
+    const uint16_t n = sizeof(ts) / sizeof(ts[0]);
+    ArchiveRecord in[n], out[n];
+    for (uint16_t i = 0; i < n; i++) in[i] = {1, 2, ts[i], 0.0f, -1.25f, 0};
+    TEST_ASSERT_TRUE(decode(encode(in, n), out, n));
+    assertSame(in, out, n);
+
+    // Реалистичный блок и блоки всех длин, включая пустой
+    ArchiveRecord blk[BLOCK];
+    milkingBlock(blk, BLOCK);
+    for (uint16_t count = 0; count <= BLOCK; count++) {
+        ArchiveRecord got[BLOCK];
+        TEST_ASSERT_TRUE(decode(encode(blk, count), got, count));
+        assertSame(blk, got, count);
+    }
+    File f = flash.open("/blk", "w", true);
+    TEST_ASSERT_FALSE(ArchiveCodec::encodeBlock(f, blk, BLOCK + 1));
+    f.close();
+}
+
+// Обрезанный на любом байте блок не распаковывается
+static void test_truncated() {
+    ArchiveRecord in[BLOCK], out[BLOCK + 1];
+    milkingBlock(in, BLOCK);
+    Bytes b = encode(in, BLOCK);
+    for (size_t len = 0; len < b.size(); len++) {
+        TEST_ASSERT_FALSE(decode(Bytes(b.begin(), b.begin() + len), out, BLOCK));
+    }
+    // Записей просят больше, чем в блоке
+    TEST_ASSERT_FALSE(decode(b, out, BLOCK + 1));
+}
+
+// Порча, которую формат может заметить: режим столбца, длина серии, varint
+static void test_corrupt() {
+    ArchiveRecord in[BLOCK], out[BLOCK];
+    for (uint16_t i = 0; i < BLOCK; i++) in[i] = {7, 42, TS_BASE, 12.5f, 5.25f, 1};
+    Bytes rle = encode(in, BLOCK);
+
+    Bytes bad = rle;
+    bad[0] = 2;                                // неизвестный режим
+    TEST_ASSERT_FALSE(decode(bad, out, BLOCK));
+
+    bad = rle;
+    bad[1] = BLOCK + 1;                        // серия длиннее блока
+    TEST_ASSERT_FALSE(decode(bad, out, BLOCK));
+
+    bad = rle;
+    bad[1] = 0;                                // пустая серия
+    TEST_ASSERT_FALSE(decode(bad, out, BLOCK));
+
+    // varint из шести байт с флагом продолжения
+    bad = {0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+    TEST_ASSERT_FALSE(decode(bad, out, 1));
+
+    // Случайный мусор не роняет декодер (результат не важен, важен выход за массив)
+    for (int round = 0; round < 2000; round++) {
+        Bytes junk(1 + esp_random() % 200);
+        for (uint8_t& c : junk) c = (uint8_t)esp_random();
+        junk[0] &= 1;
+        decode(junk, out, BLOCK);
+    }
+}
+
+// Скорость распаковки на ПК: на плате блок читается при промахе кэша хвоста
+static void test_decode_throughput() {
+    ArchiveRecord in[BLOCK], out[BLOCK];
+    milkingBlock(in, BLOCK);
+    Bytes b = encode(in, BLOCK);
+    File f = flash.open("/bench", "w", true);
+    f.write(b.data(), b.size());
+    f.close();
+
+    const int rounds = 20000;
+    f = flash.open("/bench", "r");
+    bool ok = true;
+    unsigned long t0 = micros();
+    for (int i = 0; i < rounds && ok; i++) {
+        f.seek(0);
+        ok = ArchiveCodec::decodeBlock(f, out, BLOCK);
+    }
+    unsigned long us = micros() - t0;
+    f.close();
+    TEST_ASSERT_TRUE(ok);
+    assertSame(in, out, BLOCK);
+
+    char msg[128];
+    double recs = (double)rounds * BLOCK;
+    snprintf(msg, sizeof(msg), "block %u B for %u records (%.1f B/rec), decode %.2f Mrec/s, %.1f ns/rec",
+             (unsigned)b.size(), (unsigned)BLOCK, (double)b.size() / BLOCK,
+             us ? recs / us : 0.0, us ? us * 1000.0 / recs : 0.0);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(b.size() < BLOCK * sizeof(ArchiveRecord) / 2);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_roundtrip_rle);
+    RUN_TEST(test_roundtrip_plain);
+    RUN_TEST(test_roundtrip_timestamps);
+    RUN_TEST(test_truncated);
+    RUN_TEST(test_corrupt);
+    RUN_TEST(test_decode_throughput);
+    return UNITY_END();
+}
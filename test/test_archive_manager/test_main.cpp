@@ -0,0 +1,247 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <map>
+#include <set>
+#include "ArchiveManager.h"
+#include "FlashEmulator.h"
+
+// Уплотнение и выдача архива на ПК (env:native): перенесённые в голову
+// оригиналы не попадают в счётчики и выгрузки, а каждая запись приходит
+// получателю (readSince(), потребители) ровно один раз. Флеш — FlashEmulator в RAM
+
+static const uint32_t TS_BASE = 1700000000;
+static const uint32_t SEG     = ArchiveManager::SEGMENT_RECORDS;
+// Четыре сегмента по политике — порог уплотнения три
+static const uint32_t TOTAL   = 3 * SEG + 10;
+
+// Запись i: cow_id = i, timestamp = TS_BASE + i
+static bool pendingInSeg0(uint32_t i) { return i < SEG && i % 50 == 7; }
+
+static ArchiveManager* archive;
+static FlashEmulator*  flash;
+
+static ArchiveManager* open(uint32_t maxRecords = 4 * SEG) {
+    ArchiveManager* a = new (std::nothrow) ArchiveManager();
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_TRUE(a->begin(*flash, "/archive"));
+    ArchiveRetention policy;
+    policy.maxRecords = maxRecords;
+    a->setRetention(policy);
+    return a;
+}
+
+void setUp() {
+    flash = new FlashEmulator();
+}
+
+void tearDown() {
+    delete archive;
+    delete flash;
+}
+
+// Три сегмента и хвост; уплотнению есть что переносить
+static void fillCompactable() {
+    archive = open();
+    for (uint32_t i = 0; i < TOTAL; i++) {
+        ArchiveRecord r = {1, i, TS_BASE + i, 10.0f, 5.0f, 0};
+        TEST_ASSERT_TRUE(archive->add(r));
+    }
+    // Первый сегмент отправлен, кроме нескольких застрявших записей
+    for (uint32_t i = 0; i < SEG; i++) {
+        if (!pendingInSeg0(i)) archive->updateStatus(i, 1);
+    }
+    archive->flush();
+}
+
+// Счётчики совпадают с пересчётом по выгрузке, каждая корова — один раз
+static void assertConsistent() {
+    ArchiveCounters c = archive->counters();
+    ArchiveCounters seen = {};
+    std::map<uint32_t, int> cows;
+    archive->visit(ArchiveFilter(), [&](uint32_t, const ArchiveRecord& r) {
+        seen.total++;
+        if (r.status == 0) seen.pending++;
+        else if (r.status == 1) seen.sent++;
+        else seen.error++;
+        cows[r.cow_id]++;
+        return true;
+    });
+    TEST_ASSERT_EQUAL_UINT32(seen.total, c.total);
+    TEST_ASSERT_EQUAL_UINT32(seen.pending, c.pending);
+    TEST_ASSERT_EQUAL_UINT32(seen.sent, c.sent);
+    TEST_ASSERT_EQUAL_UINT32(0, c.error);
+    for (auto& kv : cows) TEST_ASSERT_EQUAL_INT(1, kv.second);
+
+    // Выборка отправленных не содержит перенесённых неотправленных записей
+    ArchiveFilter sent;
+    sent.status = 1;
+    uint32_t wrong = 0;
+    archive->visit(sent, [&](uint32_t, const ArchiveRecord& r) {
+        wrong += pendingInSeg0(r.cow_id);
+        return true;
+    });
+    TEST_ASSERT_EQUAL_UINT32(0, wrong);
+}
+
+// Номера readSince() от нуля: каждый ровно один раз, запись по номеру своя
+static void assertReadSinceOnce(uint32_t expected) {
+    std::set<uint64_t> seqs;
+    uint64_t seq = 0;
+    ArchiveRecord out[37];
+    uint64_t outSeq[37];
+    size_t n;
+    while ((n = archive->readSince(seq, out, outSeq, 37)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            TEST_ASSERT_TRUE(seqs.insert(outSeq[i]).second);
+            TEST_ASSERT_EQUAL_UINT32((uint32_t)outSeq[i], out[i].cow_id);
+            TEST_ASSERT_TRUE(out[i].status <= 1);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(expected, seqs.size());
+}
+
+static void test_compact_moves_without_marking_sent() {
+    fillCompactable();
+    ArchiveCounters before = archive->counters();
+    TEST_ASSERT_EQUAL_UINT32(TOTAL, before.total);
+    TEST_ASSERT_EQUAL_UINT32(TOTAL - SEG + 21, before.pending);
+
+    // Шаг переносит ARCHIVE_COMPACT_BATCH записей, сегмент ещё держится
+    TEST_ASSERT_TRUE(archive->compactStep());
+    TEST_ASSERT_EQUAL_UINT32(ARCHIVE_COMPACT_BATCH, archive->compactStats().relocated);
+    TEST_ASSERT_EQUAL_UINT32(0, archive->firstIndex());
+    ArchiveCounters c = archive->counters();
+    TEST_ASSERT_EQUAL_UINT32(before.total, c.total);
+    TEST_ASSERT_EQUAL_UINT32(before.pending, c.pending);
+    TEST_ASSERT_EQUAL_UINT32(before.sent, c.sent);
+    assertConsistent();
+    assertReadSinceOnce(TOTAL);
+
+    // Оригинал по индексу не читается, отправка копии не задевает его
+    ArchiveRecord r;
+    TEST_ASSERT_FALSE(archive->readRecord(7, r));
+    archive->updateStatus(7, 1);
+    TEST_ASSERT_EQUAL_UINT32(before.sent, archive->counters().sent);
+
+    // После перезапуска отметки переноса восстанавливаются из журнала
+    delete archive;
+    archive = open();
+    c = archive->counters();
+    TEST_ASSERT_EQUAL_UINT32(before.total, c.total);
+    TEST_ASSERT_EQUAL_UINT32(before.pending, c.pending);
+    assertConsistent();
+
+    // Второй шаг переносит остаток и освобождает сегмент
+    TEST_ASSERT_TRUE(archive->compactStep());
+    TEST_ASSERT_EQUAL_UINT32(SEG, archive->firstIndex());
+    c = archive->counters();
+    TEST_ASSERT_EQUAL_UINT32(TOTAL - SEG + 21, c.total);
+    TEST_ASSERT_EQUAL_UINT32(before.pending, c.pending);
+    TEST_ASSERT_EQUAL_UINT32(0, c.sent);
+    assertConsistent();
+    assertReadSinceOnce(TOTAL - SEG + 21);
+}
+
+// Потребитель забирает записи до номера limit, подтверждая по одной
+static void drainConsumer(uint8_t id, uint32_t limit, std::set<uint32_t>& got) {
+    uint32_t index;
+    ArchiveRecord r;
+    while (archive->consumerNext(id, index, r) && index < limit) {
+        TEST_ASSERT_TRUE(got.insert(index).second);       // без повторов
+        TEST_ASSERT_EQUAL_UINT32(index, r.cow_id);
+        archive->consumerAck(id, index + 1);
+    }
+}
+
+// Потребители впереди, посреди и позади перенесённых записей получают
+// каждую запись ровно раз; отставшему достаются копии удалённых оригиналов
+static void test_consumers_after_compaction() {
+    fillCompactable();
+    int8_t ahead = archive->openConsumer("ahead");
+    int8_t middle = archive->openConsumer("middle");
+    int8_t behind = archive->openConsumer("behind");
+    TEST_ASSERT_TRUE(ahead >= 0 && middle >= 0 && behind >= 0);
+    std::set<uint32_t> gotAhead, gotMiddle, gotBehind;
+    drainConsumer(ahead, 2 * SEG, gotAhead);
+    drainConsumer(middle, SEG / 2, gotMiddle);
+
+    TEST_ASSERT_TRUE(archive->compactStep());
+    drainConsumer(middle, SEG / 2 + 200, gotMiddle);
+    TEST_ASSERT_TRUE(archive->compactStep());
+    TEST_ASSERT_EQUAL_UINT32(SEG, archive->firstIndex());
+
+    drainConsumer(ahead, UINT32_MAX, gotAhead);
+    drainConsumer(middle, UINT32_MAX, gotMiddle);
+    drainConsumer(behind, UINT32_MAX, gotBehind);
+    TEST_ASSERT_EQUAL_UINT32(TOTAL, gotAhead.size());
+
+    // Удалённые отправленные записи пропали, застрявшие — нет
+    for (uint32_t i = 0; i < TOTAL; i++) {
+        bool kept = i >= SEG || pendingInSeg0(i);
+        TEST_ASSERT_EQUAL(kept || i < SEG / 2 + 200, gotMiddle.count(i) == 1);
+        TEST_ASSERT_EQUAL(kept, gotBehind.count(i) == 1);
+    }
+    uint32_t index;
+    ArchiveRecord r;
+    TEST_ASSERT_FALSE(archive->consumerNext(ahead, index, r));
+    TEST_ASSERT_EQUAL_UINT32(0, archive->consumerLag(behind));
+}
+
+// Обход сжатого сегмента, пока колбэк читает другие сегменты и вытесняет
+// его карту статусов: статусы берутся из журнала своего сегмента
+static void test_scan_keeps_status_map_across_callback() {
+    archive = open(0);
+    const uint32_t segs = ARCHIVE_STATUS_MAPS + 2;
+    for (uint32_t i = 0; i < segs * SEG + 1; i++) {
+        ArchiveRecord r = {1, i, TS_BASE + i, 10.0f, 5.0f, 0};
+        TEST_ASSERT_TRUE(archive->add(r));
+    }
+    for (uint32_t i = 0; i < SEG; i++) archive->updateStatus(i, 1);
+    archive->flush();
+
+    uint32_t seen = 0, wrong = 0;
+    archive->visit(ArchiveFilter(), [&](uint32_t idx, const ArchiveRecord& r) {
+        if (idx >= SEG) return false;
+        if (r.status != 1) wrong++;
+        seen++;
+        ArchiveRecord other;
+        for (uint32_t seg = 1; seg < segs; seg++) archive->readRecord(seg * SEG + idx % 7, other);
+        return true;
+    });
+    TEST_ASSERT_EQUAL_UINT32(SEG, seen);
+    TEST_ASSERT_EQUAL_UINT32(0, wrong);
+}
+
+// Архив полон неотправленными: повторы drain() одной и той же записи из
+// очереди приёма считаются в rejected один раз
+static void test_rejected_counted_once_per_record() {
+    archive = open(2 * SEG);
+    for (uint32_t i = 0; i < 2 * SEG; i++) {
+        ArchiveRecord r = {1, i, TS_BASE + i, 10.0f, 5.0f, 0};
+        TEST_ASSERT_TRUE(archive->add(r));
+    }
+    ArchiveRecord extra = {1, 2 * SEG, TS_BASE + 2 * SEG, 10.0f, 5.0f, 0};
+    TEST_ASSERT_TRUE(archive->enqueue(extra));
+    for (int retry = 0; retry < 5; retry++) TEST_ASSERT_EQUAL_UINT16(0, archive->drain(4));
+    TEST_ASSERT_EQUAL_UINT32(1, archive->retentionStats().rejected);
+    TEST_ASSERT_EQUAL_UINT32(1, archive->ingestBacklog());
+
+    // Прямой add() — отдельная попытка, считается каждая
+    TEST_ASSERT_FALSE(archive->add(extra));
+    TEST_ASSERT_EQUAL_UINT32(2, archive->retentionStats().rejected);
+
+    // Старый сегмент отправлен — запись из очереди проходит
+    for (uint32_t i = 0; i < SEG; i++) archive->updateStatus(i, 1);
+    TEST_ASSERT_EQUAL_UINT16(1, archive->drain(4));
+    TEST_ASSERT_EQUAL_UINT32(0, archive->ingestBacklog());
+    TEST_ASSERT_EQUAL_UINT32(2, archive->retentionStats().rejected);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_compact_moves_without_marking_sent);
+    RUN_TEST(test_consumers_after_compaction);
+    RUN_TEST(test_scan_keeps_status_map_across_callback);
+    RUN_TEST(test_rejected_counted_once_per_record);
+    return UNITY_END();
+}
@@ -0,0 +1,128 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Crc.h"
+
+// CRC на ПК (env:native): контрольные значения, продолжение по частям,
+// сверка таблиц с побитовым счётом и скорость
+
+static const uint8_t CHECK[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+// Побитовые эталоны тех же параметров (см. Crc.h)
+static uint8_t bitCrc8(const uint8_t* p, size_t n) {
+    uint8_t crc = 0x00;
+    while (n--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) crc = crc & 0x80 ? (uint8_t)(crc << 1 ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static uint16_t bitCrc16(const uint8_t* p, size_t n) {
+    uint16_t crc = 0xFFFF;
+    while (n--) {
+        crc ^= (uint16_t)(*p++ << 8);
+        for (int i = 0; i < 8; i++) crc = crc & 0x8000 ? (uint16_t)(crc << 1 ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static uint32_t bitCrc32(const uint8_t* p, size_t n) {
+    uint32_t crc = 0xFFFFFFFF;
+    while (n--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) crc = crc & 1 ? crc >> 1 ^ 0xEDB88320 : crc >> 1;
+    }
+    return ~crc;
+}
+
+static void fill(uint8_t* buf, size_t n) {
+    for (size_t i = 0; i < n; i++) buf[i] = (uint8_t)esp_random();
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Стандартное контрольное значение каждого CRC на "123456789"
+static void test_check_values() {
+    TEST_ASSERT_EQUAL_HEX8(0xF4, Crc::crc8(CHECK, sizeof(CHECK)));
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, Crc::crc16(CHECK, sizeof(CHECK)));
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, Crc::crc32(CHECK, sizeof(CHECK)));
+    // Пустые данные — начальное значение
+    TEST_ASSERT_EQUAL_HEX8(Crc::CRC8_INIT, Crc::crc8(CHECK, 0));
+    TEST_ASSERT_EQUAL_HEX16(Crc::CRC16_INIT, Crc::crc16(CHECK, 0));
+    TEST_ASSERT_EQUAL_HEX32(0, Crc::crc32(CHECK, 0));
+}
+
+// Продолжение с результата прошлого вызова равно счёту за один вызов
+static void test_chaining() {
+    uint8_t buf[300];
+    fill(buf, sizeof(buf));
+    uint8_t  one8  = Crc::crc8(buf, sizeof(buf));
+    uint16_t one16 = Crc::crc16(buf, sizeof(buf));
+    uint32_t one32 = Crc::crc32(buf, sizeof(buf));
+    for (size_t cut = 0; cut <= sizeof(buf); cut++) {
+        size_t rest = sizeof(buf) - cut;
+        TEST_ASSERT_EQUAL_HEX8(one8, Crc::crc8(buf + cut, rest, Crc::crc8(buf, cut)));
+        TEST_ASSERT_EQUAL_HEX16(one16, Crc::crc16(buf + cut, rest, Crc::crc16(buf, cut)));
+        TEST_ASSERT_EQUAL_HEX32(one32, Crc::crc32(buf + cut, rest, Crc::crc32(buf, cut)));
+    }
+    // Побайтово — как заголовок кадра и payload по отдельности
+    uint16_t crc = Crc::CRC16_INIT;
+    for (size_t i = 0; i < sizeof(buf); i++) crc = Crc::crc16(buf + i, 1, crc);
+    TEST_ASSERT_EQUAL_HEX16(one16, crc);
+}
+
+// Таблицы дают то же, что побитовый счёт
+static void test_tables_match_bitwise() {
+    uint8_t buf[1024];
+    for (int round = 0; round < 16; round++) {
+        size_t n = 1 + esp_random() % sizeof(buf);
+        fill(buf, n);
+        TEST_ASSERT_EQUAL_HEX8(bitCrc8(buf, n), Crc::crc8(buf, n));
+        TEST_ASSERT_EQUAL_HEX16(bitCrc16(buf, n), Crc::crc16(buf, n));
+        TEST_ASSERT_EQUAL_HEX32(bitCrc32(buf, n), Crc::crc32(buf, n));
+    }
+}
+
+// Время rounds проходов fn по буферу, мкс
+template <typename Fn>
+static uint32_t timeRounds(const uint8_t* buf, size_t n, int rounds, Fn fn) {
+    volatile uint32_t sink = 0;
+    unsigned long t0 = micros();
+    for (int i = 0; i < rounds; i++) sink += fn(buf, n);
+    (void)sink;
+    return (uint32_t)(micros() - t0);
+}
+
+// Скорость на ПК — для сравнения табличного счёта с побитовым, не для платы
+static void test_throughput() {
+    static uint8_t buf[64 * 1024];
+    const int rounds = 32;
+    fill(buf, sizeof(buf));
+    struct Case { const char* name; uint32_t us; } cases[] = {
+        {"crc8 table",    timeRounds(buf, sizeof(buf), rounds, [](const uint8_t* p, size_t n) { return Crc::crc8(p, n); })},
+        {"crc8 bitwise",  timeRounds(buf, sizeof(buf), rounds, bitCrc8)},
+        {"crc16 table",   timeRounds(buf, sizeof(buf), rounds, [](const uint8_t* p, size_t n) { return Crc::crc16(p, n); })},
+        {"crc16 bitwise", timeRounds(buf, sizeof(buf), rounds, bitCrc16)},
+        {"crc32 nibble",  timeRounds(buf, sizeof(buf), rounds, [](const uint8_t* p, size_t n) { return Crc::crc32(p, n); })},
+        {"crc32 bitwise", timeRounds(buf, sizeof(buf), rounds, bitCrc32)},
+    };
+    for (const Case& c : cases) {
+        char msg[64];
+        double mbps = c.us ? (double)sizeof(buf) * rounds / c.us : 0;
+        snprintf(msg, sizeof(msg), "%-14s %8.1f MB/s", c.name, mbps);
+        TEST_MESSAGE(msg);
+    }
+    // Таблица не медленнее побитового счёта (с запасом на шум таймера)
+    TEST_ASSERT_TRUE(cases[0].us <= cases[1].us * 2);
+    TEST_ASSERT_TRUE(cases[2].us <= cases[3].us * 2);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_check_values);
+    RUN_TEST(test_chaining);
+    RUN_TEST(test_tables_match_bitwise);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
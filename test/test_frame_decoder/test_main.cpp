@@ -0,0 +1,176 @@
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "RS485FrameDecoder.h"
+
+// Разбор кадров RS485 на ПК (env:native): фрагментация, ложный Start,
+// порченые CRC/End и expire()
+
+typedef std::vector<uint8_t> Bytes;
+
+// Копии констант декодера: push_back() берёт ссылку, а у static const
+// членов класса нет определения вне класса
+static const uint8_t START   = RS485FrameDecoder::START;
+static const uint8_t START16 = RS485FrameDecoder::START16;
+static const uint8_t END     = RS485FrameDecoder::END;
+
+// Кадр как его собирает RS485Manager::sendFrame()
+static Bytes frame(const Bytes& payload, bool strong = false) {
+    Bytes f;
+    f.push_back(strong ? START16 : START);
+    f.push_back((uint8_t)payload.size());
+    f.insert(f.end(), payload.begin(), payload.end());
+    if (strong) {
+        uint16_t crc = Crc::crc16(f.data(), f.size());
+        f.push_back(crc >> 8);
+        f.push_back(crc & 0xFF);
+    } else {
+        f.push_back(Crc::crc8(f.data(), f.size()));
+    }
+    f.push_back(END);
+    return f;
+}
+
+// Подать байты по одному, собранные кадры — в out
+static void feed(RS485FrameDecoder& dec, const Bytes& bytes, std::vector<Bytes>& out) {
+    for (uint8_t b : bytes) {
+        if (dec.push(b)) out.push_back(Bytes(dec.payload(), dec.payload() + dec.length()));
+        while (dec.poll()) out.push_back(Bytes(dec.payload(), dec.payload() + dec.length()));
+    }
+}
+
+static Bytes concat(std::initializer_list<Bytes> parts) {
+    Bytes r;
+    for (const Bytes& p : parts) r.insert(r.end(), p.begin(), p.end());
+    return r;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Кадр собирается только на последнем байте, как бы ни дробился поток
+static void test_byte_by_byte() {
+    Bytes payload = {1, 2, 3, 4, 5, 6, 7, 8};
+    Bytes f = frame(payload);
+    RS485FrameDecoder dec;
+    for (size_t i = 0; i + 1 < f.size(); i++) {
+        TEST_ASSERT_FALSE(dec.push(f[i]));
+        TEST_ASSERT_TRUE(dec.busy());
+    }
+    TEST_ASSERT_TRUE(dec.push(f.back()));
+    TEST_ASSERT_EQUAL_UINT8(payload.size(), dec.length());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(payload.data(), dec.payload(), payload.size());
+    TEST_ASSERT_FALSE(dec.crc16());
+    TEST_ASSERT_FALSE(dec.busy());
+    TEST_ASSERT_EQUAL_UINT32(1, dec.stats().frames);
+}
+
+// Кадры вплотную и с мусором между ними, CRC-8 и CRC-16 вперемешку
+static void test_stream_with_noise() {
+    Bytes a = {0x10, 0x20}, b = {0x30}, c(200, 0x5A);
+    Bytes stream = concat({{0x00, 0x55, 0x13}, frame(a), frame(b, true), {0x77, 0x55}, frame(c)});
+    RS485FrameDecoder dec;
+    std::vector<Bytes> got;
+    feed(dec, stream, got);
+    TEST_ASSERT_EQUAL(3, got.size());
+    TEST_ASSERT_TRUE(got[0] == a);
+    TEST_ASSERT_TRUE(got[1] == b);
+    TEST_ASSERT_TRUE(got[2] == c);
+    RS485DecoderStats s = dec.stats();
+    TEST_ASSERT_EQUAL_UINT32(3, s.frames);
+    TEST_ASSERT_EQUAL_UINT32(5, s.skipped);
+    TEST_ASSERT_EQUAL_UINT32(0, s.crcErrors + s.badFrames);
+}
+
+// 0xAA/0xAB внутри payload и ложный Start перед кадром не теряют кадры
+static void test_false_start() {
+    Bytes inner = {START, 3, START16, 1, END, START};
+    Bytes next = {9, 9};
+    // Ложный Start с длиной 3 захватывает начало настоящего кадра
+    Bytes stream = concat({{START, 3, 0x01}, frame(inner), frame(next)});
+    RS485FrameDecoder dec;
+    std::vector<Bytes> got;
+    feed(dec, stream, got);
+    TEST_ASSERT_EQUAL(2, got.size());
+    TEST_ASSERT_TRUE(got[0] == inner);
+    TEST_ASSERT_TRUE(got[1] == next);
+    TEST_ASSERT_EQUAL_UINT32(2, dec.stats().frames);
+}
+
+// Порченый CRC: кадр отброшен, следующий принят
+static void test_bad_crc() {
+    Bytes p8 = {1, 2, 3}, p16 = {4, 5, 6}, good = {7};
+    Bytes bad8 = frame(p8), bad16 = frame(p16, true);
+    bad8[bad8.size() - 2] ^= 0x01;
+    bad16[bad16.size() - 3] ^= 0x80;
+    RS485FrameDecoder dec;
+    std::vector<Bytes> got;
+    feed(dec, concat({bad8, bad16, frame(good)}), got);
+    TEST_ASSERT_EQUAL(1, got.size());
+    TEST_ASSERT_TRUE(got[0] == good);
+    TEST_ASSERT_EQUAL_UINT32(2, dec.stats().crcErrors);
+
+    // Порча payload ловится так же, как порча самого CRC
+    Bytes bad = frame(p8);
+    bad[3] ^= 0x40;
+    got.clear();
+    feed(dec, concat({bad, frame(good)}), got);
+    TEST_ASSERT_EQUAL(1, got.size());
+    TEST_ASSERT_EQUAL_UINT32(3, dec.stats().crcErrors);
+}
+
+// Не тот End-байт или длина больше допустимой — кадр отброшен
+static void test_bad_end_and_length() {
+    Bytes p = {1, 2, 3}, good = {8, 8};
+    Bytes badEnd = frame(p);
+    badEnd.back() = 0x56;
+    RS485FrameDecoder dec(16);
+    std::vector<Bytes> got;
+    feed(dec, concat({badEnd, frame(good)}), got);
+    TEST_ASSERT_EQUAL(1, got.size());
+    TEST_ASSERT_TRUE(got[0] == good);
+    TEST_ASSERT_EQUAL_UINT32(1, dec.stats().badFrames);
+
+    got.clear();
+    feed(dec, concat({frame(Bytes(17, 1)), frame(good)}), got);
+    TEST_ASSERT_EQUAL(1, got.size());
+    TEST_ASSERT_TRUE(got[0] == good);
+    TEST_ASSERT_EQUAL_UINT32(2, dec.stats().badFrames);
+}
+
+// Ложный Start с большой длиной держит кадр в окне, пока не вызван expire()
+static void test_expire() {
+    RS485FrameDecoder dec;
+    TEST_ASSERT_FALSE(dec.expire());   // пустое окно
+
+    Bytes good = {1, 2, 3, 4};
+    std::vector<Bytes> got;
+    feed(dec, concat({{START, 200}, frame(good)}), got);
+    TEST_ASSERT_EQUAL(0, got.size());
+    TEST_ASSERT_TRUE(dec.busy());
+
+    TEST_ASSERT_TRUE(dec.expire());
+    TEST_ASSERT_EQUAL_UINT8(good.size(), dec.length());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(good.data(), dec.payload(), good.size());
+    TEST_ASSERT_FALSE(dec.busy());
+    TEST_ASSERT_EQUAL_UINT32(1, dec.stats().badFrames);
+
+    // Оборванный кадр без продолжения: expire() очищает окно
+    Bytes cut = frame(good);
+    cut.resize(cut.size() - 2);
+    feed(dec, cut, got);
+    TEST_ASSERT_TRUE(dec.busy());
+    while (dec.busy()) TEST_ASSERT_FALSE(dec.expire());
+    TEST_ASSERT_EQUAL_UINT32(1, dec.stats().frames);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_byte_by_byte);
+    RUN_TEST(test_stream_with_noise);
+    RUN_TEST(test_false_start);
+    RUN_TEST(test_bad_crc);
+    RUN_TEST(test_bad_end_and_length);
+    RUN_TEST(test_expire);
+    return UNITY_END();
+}
@@ -0,0 +1,176 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "ArchiveManager.h"
+#include "FlashEmulator.h"
+#include "SpscQueue.h"
+
+// Очередь приёма и архив под нагрузкой из нескольких потоков (env:native):
+// производитель и писатель через SpscQueue, читатели архива параллельно
+// с записью. На ПК потоки действительно идут одновременно, поэтому
+// пропущенный acquire/release или мьютекс ловится здесь, а не в коровнике
+
+static const uint32_t TS_BASE = 1700000000;
+
+// Элемент с проверкой целостности: потребитель не должен увидеть
+// половину старого и половину нового значения
+struct Item {
+    uint32_t seq;
+    uint32_t check;
+    uint8_t  pad[24];
+};
+
+void setUp() {}
+void tearDown() {}
+
+// Производитель кладёт 0..N-1, потребитель забирает: порядок сохранён, ничего не потеряно
+static void test_spsc_order_and_loss() {
+    static SpscQueue<Item, 64> q;
+    const uint32_t N = 1000000;
+    std::atomic<uint32_t> full{0};
+
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < N; i++) {
+            Item it;
+            it.seq = i;
+            it.check = ~i;
+            memset(it.pad, (uint8_t)i, sizeof(it.pad));
+            while (!q.push(it)) { full++; std::this_thread::yield(); }
+        }
+    });
+
+    uint32_t expected = 0, torn = 0, outOfOrder = 0, peeked = 0;
+    Item it, head;
+    while (expected < N) {
+        if (q.peek(head)) {
+            TEST_ASSERT_TRUE(q.pop(it));
+            if (head.seq == it.seq) peeked++;
+        } else if (!q.pop(it)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (it.check != ~it.seq || it.pad[0] != (uint8_t)it.seq || it.pad[23] != (uint8_t)it.seq) torn++;
+        if (it.seq != expected) outOfOrder++;
+        expected = it.seq + 1;
+    }
+    producer.join();
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%u items, producer saw full queue %u times", (unsigned)N, (unsigned)full.load());
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(N, peeked);
+    TEST_ASSERT_EQUAL_UINT32(0, q.size());
+    Item none;
+    TEST_ASSERT_FALSE(q.pop(none));
+}
+
+// Очередь на границе ёмкости: ровно N элементов, (N+1)-й не принят
+static void test_spsc_capacity() {
+    SpscQueue<uint32_t, 8> q;
+    for (uint32_t i = 0; i < q.capacity(); i++) TEST_ASSERT_TRUE(q.push(i));
+    TEST_ASSERT_FALSE(q.push(99));
+    uint32_t v;
+    TEST_ASSERT_TRUE(q.pop(v));
+    TEST_ASSERT_EQUAL_UINT32(0, v);
+    TEST_ASSERT_TRUE(q.push(8));
+    for (uint32_t i = 1; i <= 8; i++) {
+        TEST_ASSERT_TRUE(q.pop(v));
+        TEST_ASSERT_EQUAL_UINT32(i, v);
+    }
+    TEST_ASSERT_FALSE(q.peek(v));
+}
+
+// Производитель → enqueue(), писатель → drain(), два читателя читают архив
+// всё это время: записи в архиве по порядку, без потерь, читатели не видят
+// незаписанных или чужих записей
+static void test_archive_ingest_with_readers() {
+    FlashEmulator flash;
+    ArchiveManager* archive = new (std::nothrow) ArchiveManager();
+    TEST_ASSERT_NOT_NULL(archive);
+    TEST_ASSERT_TRUE(archive->begin(flash, "/archive"));
+    archive->setGroupCommit(16, 0);
+
+    const uint32_t N = 3000;
+    std::atomic<bool> produced{false}, written{false};
+    std::atomic<uint32_t> readerErrors{0}, reads{0};
+
+    // Запись i: cow_id = i, timestamp = TS_BASE + i — читатель проверяет связь
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < N; i++) {
+            ArchiveRecord r = {1, i, TS_BASE + i, 10.0f + (i % 50) * 0.1f, 5.0f, 0};
+            while (!archive->enqueue(r)) std::this_thread::yield();
+        }
+        produced = true;
+    });
+
+    uint32_t next = 0, skipped = 0;
+    std::thread writer([&] {
+        for (;;) {
+            bool done = produced;
+            archive->drain(ARCHIVE_INGEST_QUEUE,
+                           [&](const ArchiveRecord& r) { return r.cow_id % 97 == 96 && ++skipped; },
+                           [&](const ArchiveRecord& r) { if (r.cow_id < next) readerErrors++; next = r.cow_id + 1; });
+            archive->poll();
+            if (done && archive->ingestBacklog() == 0) break;
+            std::this_thread::yield();
+        }
+        archive->flush();
+        written = true;
+    });
+
+    auto reader = [&] {
+        uint32_t lastTotal = 0;
+        ArchiveRecord rec, last[2];
+        while (!written) {
+            ArchiveCounters c = archive->counters();
+            if (c.total < lastTotal) readerErrors++;
+            lastTotal = c.total;
+
+            uint32_t end = archive->endIndex();
+            if (end > 0) {
+                if (!archive->readRecord(end - 1, rec) || rec.timestamp != TS_BASE + rec.cow_id) readerErrors++;
+                size_t n = archive->lastMilkings(rec.cow_id, last, 2);
+                if (n != 1 || last[0].timestamp != rec.timestamp) readerErrors++;
+            }
+            reads++;
+        }
+    };
+    std::thread r1(reader), r2(reader);
+
+    producer.join();
+    writer.join();
+    r1.join();
+    r2.join();
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%u records, %u skipped, %u reads alongside the writer",
+             (unsigned)N, (unsigned)skipped, (unsigned)reads.load());
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL_UINT32(0, readerErrors.load());
+    TEST_ASSERT_EQUAL_UINT32(0, archive->ingestBacklog());
+
+    // Все непропущенные записи — ровно по разу и по порядку
+    TEST_ASSERT_EQUAL_UINT32(N - skipped, archive->counters().total);
+    uint32_t expect = 0, index = 0;
+    archive->query(0, UINT32_MAX, [&](uint32_t, const ArchiveRecord& r) {
+        while (expect % 97 == 96) expect++;
+        if (r.cow_id != expect || r.timestamp != TS_BASE + expect) readerErrors++;
+        expect++;
+        index++;
+        return true;
+    });
+    TEST_ASSERT_EQUAL_UINT32(N - skipped, index);
+    TEST_ASSERT_EQUAL_UINT32(0, readerErrors.load());
+    delete archive;
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_spsc_order_and_loss);
+    RUN_TEST(test_spsc_capacity);
+    RUN_TEST(test_archive_ingest_with_readers);
+    return UNITY_END();
+}
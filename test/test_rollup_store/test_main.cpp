@@ -0,0 +1,182 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <vector>
+#include "ArchiveManager.h"
+#include "FlashEmulator.h"
+#include "RollupStore.h"
+
+// Суточные итоги на ПК (env:native): восстановление после сбоя посреди
+// пачки журнала и посреди свёртки, prune() и предел периода range().
+// Флеш — FlashEmulator в RAM
+
+typedef std::vector<uint8_t> Bytes;
+
+static const uint32_t DAY0 = 19700;   // сутки около 2023-12
+static const uint32_t COW  = 42;
+
+static FlashEmulator* flash;
+static uint32_t       added;   // индекс архива для flush()
+
+static Bytes readFile(const char* path) {
+    File f = flash->open(path, "r");
+    Bytes b(f ? f.size() : 0);
+    if (f) {
+        f.read(b.data(), b.size());
+        f.close();
+    }
+    return b;
+}
+
+static void writeFile(const char* path, const Bytes& b) {
+    File f = flash->open(path, "w");
+    TEST_ASSERT_TRUE((bool)f);
+    if (!b.empty()) f.write(b.data(), b.size());
+    f.close();
+}
+
+// n доений коровы в сутки day и сброс пачкой
+static void milk(RollupStore& store, uint32_t day, uint16_t n, uint32_t cow = COW) {
+    for (uint16_t i = 0; i < n; i++) {
+        ArchiveRecord r = {1, cow, day * 86400 + 3600 + i * 60, 10.0f, 4.0f + i * 0.5f, 0};
+        TEST_ASSERT_TRUE(store.add(r));
+        added++;
+    }
+    TEST_ASSERT_TRUE(store.flush(added));
+}
+
+static uint16_t sessions(RollupStore& store, uint32_t day, uint32_t cow = COW) {
+    RollupRow row;
+    return store.get(cow, day, row) ? row.sessions : 0;
+}
+
+void setUp() {
+    flash = new FlashEmulator();
+    added = 0;
+}
+
+void tearDown() {
+    delete flash;
+}
+
+// Сбой посреди дозаписи пачки: рваная пачка отбрасывается целиком,
+// rolledEnd — по последней целой, и архив досчитает хвост ровно раз
+static void test_journal_torn_batch() {
+    RollupStore store;
+    TEST_ASSERT_TRUE(store.begin(*flash, "/rollup"));
+    milk(store, DAY0, 3);
+    Bytes whole = readFile("/rollup/journal");
+    milk(store, DAY0, 2);
+    Bytes two = readFile("/rollup/journal");
+    TEST_ASSERT_TRUE(two.size() > whole.size());
+
+    // Вторая пачка записана не до конца
+    writeFile("/rollup/journal", Bytes(two.begin(), two.end() - 5));
+    RollupStore reopened;
+    TEST_ASSERT_TRUE(reopened.begin(*flash, "/rollup"));
+    TEST_ASSERT_EQUAL_UINT32(3, reopened.rolledEnd());
+    TEST_ASSERT_EQUAL_UINT16(3, sessions(reopened, DAY0));
+    TEST_ASSERT_EQUAL_UINT32(whole.size(), readFile("/rollup/journal").size());
+
+    // Испорченная (не рваная) пачка — то же самое
+    Bytes bad = two;
+    bad[whole.size() + 30] ^= 0x55;
+    writeFile("/rollup/journal", bad);
+    RollupStore corrupted;
+    TEST_ASSERT_TRUE(corrupted.begin(*flash, "/rollup"));
+    TEST_ASSERT_EQUAL_UINT32(3, corrupted.rolledEnd());
+    TEST_ASSERT_EQUAL_UINT16(3, sessions(corrupted, DAY0));
+}
+
+// Сбой после записи файла суток, но до переписывания журнала: свёрнутые
+// приращения остались в журнале, folded_end не даёт учесть их дважды
+static void test_fold_interrupted_before_journal_rewrite() {
+    RollupStore store;
+    TEST_ASSERT_TRUE(store.begin(*flash, "/rollup"));
+    milk(store, DAY0, 3);
+    Bytes before = readFile("/rollup/journal");
+
+    // Новые сутки: пачка дописана, DAY0 свёрнут, журнал переписан без него
+    milk(store, DAY0 + 1, 1);
+    TEST_ASSERT_TRUE(flash->exists("/rollup/00004CF4.day"));
+    Bytes after = readFile("/rollup/journal");
+    TEST_ASSERT_EQUAL_UINT16(3, sessions(store, DAY0));
+
+    // Переписанный журнал — одна пачка с приращениями DAY0 + 1, та же, что
+    // была дописана перед свёрткой: до переписывания журнал был before + after
+    Bytes crashed = before;
+    crashed.insert(crashed.end(), after.begin(), after.end());
+    writeFile("/rollup/journal", crashed);
+
+    RollupStore reopened;
+    TEST_ASSERT_TRUE(reopened.begin(*flash, "/rollup"));
+    TEST_ASSERT_EQUAL_UINT32(4, reopened.rolledEnd());
+    TEST_ASSERT_EQUAL_UINT16(3, sessions(reopened, DAY0));
+    TEST_ASSERT_EQUAL_UINT16(1, sessions(reopened, DAY0 + 1));
+    RollupRow total = reopened.range(COW, DAY0, DAY0 + 1);
+    TEST_ASSERT_EQUAL_UINT16(4, total.sessions);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 40.0f, total.volume);
+
+    // Следующая свёртка (всё ещё с повтором в журнале) тоже не удваивает
+    milk(reopened, DAY0 + 2, 1);
+    TEST_ASSERT_EQUAL_UINT16(3, sessions(reopened, DAY0));
+    TEST_ASSERT_EQUAL_UINT16(1, sessions(reopened, DAY0 + 1));
+}
+
+// prune() удаляет файлы суток раньше границы; остальные итоги на месте
+static void test_prune() {
+    RollupStore store;
+    TEST_ASSERT_TRUE(store.begin(*flash, "/rollup"));
+    for (uint32_t d = 0; d < 5; d++) milk(store, DAY0 + d, 2);
+    TEST_ASSERT_EQUAL_UINT32(2, store.prune(DAY0 + 2));
+    TEST_ASSERT_EQUAL_UINT32(0, store.prune(DAY0 + 2));
+    TEST_ASSERT_EQUAL_UINT16(0, sessions(store, DAY0));
+    TEST_ASSERT_EQUAL_UINT16(0, sessions(store, DAY0 + 1));
+    for (uint32_t d = 2; d < 5; d++) TEST_ASSERT_EQUAL_UINT16(2, sessions(store, DAY0 + d));
+    TEST_ASSERT_EQUAL_UINT16(6, store.range(COW, DAY0, DAY0 + 4).sessions);
+
+    RollupStore reopened;
+    TEST_ASSERT_TRUE(reopened.begin(*flash, "/rollup"));
+    TEST_ASSERT_EQUAL_UINT16(0, sessions(reopened, DAY0 + 1));
+    TEST_ASSERT_EQUAL_UINT16(6, reopened.range(COW, DAY0, DAY0 + 4).sessions);
+}
+
+// range() совпадает с get() по дням (файлы суток, журнал, RAM) и не
+// длиннее ROLLUP_MAX_RANGE суток до последних суток с записями
+static void test_range_matches_get_and_is_capped() {
+    RollupStore store;
+    TEST_ASSERT_TRUE(store.begin(*flash, "/rollup"));
+    const uint32_t days = ROLLUP_MAX_RANGE + 10;
+    for (uint32_t d = 0; d < days; d++) milk(store, DAY0 + d, 1 + d % 3);
+    milk(store, DAY0 + days - 1, 2, COW + 1);      // другая корова в журнале
+    ArchiveRecord r = {1, COW, (DAY0 + days - 1) * 86400 + 7200, 5.0f, 6.0f, 0};
+    TEST_ASSERT_TRUE(store.add(r));                 // и несброшенное приращение
+
+    uint32_t first = 0, count = 0, sum = 0;
+    RollupRow total = store.range(COW, 0, UINT32_MAX, [&](uint32_t day, const RollupRow& row) {
+        if (!count) first = day;
+        count++;
+        sum += row.sessions;
+        TEST_ASSERT_EQUAL_UINT32(COW, row.cow_id);
+        TEST_ASSERT_EQUAL_UINT16(sessions(store, day), row.sessions);
+        return true;
+    });
+    TEST_ASSERT_EQUAL_UINT32(ROLLUP_MAX_RANGE, count);
+    TEST_ASSERT_EQUAL_UINT32(DAY0 + days - ROLLUP_MAX_RANGE, first);
+    TEST_ASSERT_EQUAL_UINT32(sum, total.sessions);
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, total.ec_min);
+    TEST_ASSERT_EQUAL_FLOAT(6.0f, total.ec_max);
+
+    // Остановка колбэком
+    count = 0;
+    store.range(COW, DAY0, DAY0 + days, [&](uint32_t, const RollupRow&) { return ++count < 3; });
+    TEST_ASSERT_EQUAL_UINT32(3, count);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_journal_torn_batch);
+    RUN_TEST(test_fold_interrupted_before_journal_rewrite);
+    RUN_TEST(test_prune);
+    RUN_TEST(test_range_matches_get_and_is_capped);
+    return UNITY_END();
+}